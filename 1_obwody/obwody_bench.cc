@@ -0,0 +1,327 @@
+/*
+  Benchmark of obwody's reader and writer, run on netlists made by obwody_generator.
+
+  g++ -Wall -Wextra -O2 -std=c++17 -pthread obwody_bench.cc -o obwody_bench
+  ./obwody_generator --elements 1000000 > netlist.in && ./obwody_bench [--repeat R] [--threads N]
+                     [--record BASELINE | --check BASELINE [--tolerance P]] netlist.in
+
+  Every phase is repeated R times and the fastest run is reported, together with the peak resident
+  set size of the process during the phase and its growth over the resident set size at the start of the
+  phase. The peak is reset before every run of a phase by writing "5" to /proc/self/clear_refs and read
+  from VmHWM of /proc/self/status; where that is not possible, the lifetime peak of the process is reported.
+  Inputs of a phase (like the stream with the netlist) are prepared outside of the measured time and
+  memory, and the circuit read by the previous run is destroyed before the next one. The file is loaded
+  to memory before reader::read_data runs, so its time does not include disk reads;
+  parallel_reader::read_file maps the file itself. Errors and output are formatted but discarded.
+  The tokenizer alone, scanner::scan_line, is measured at every level of vectorization the processor
+  supports, so they can be compared.
+
+  --record writes the throughput of every phase to BASELINE, --check compares the throughput with the one
+  recorded in BASELINE and fails if any phase got slower by more than fraction P (0.25 by default); phases
+  which took less than 10 ms when recorded are too short to be compared and are skipped.
+  obwody_bench.baseline holds the throughput of the default generated netlist (obwody_generator without
+  options) measured with --repeat 5 --threads 1; it has to be recorded again on the machine which checks it.
+*/
+
+#define OBWODY_NO_MAIN
+#include "src/obwody.cc"
+
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <sys/resource.h>
+
+namespace {
+
+    const char *const USAGE = "Usage: obwody_bench [--repeat R] [--threads N] "
+                              "[--record BASELINE | --check BASELINE [--tolerance P]] FILE";
+
+    struct bench_options {
+        string path;
+        int cnt_repeats = 3;
+        unsigned cnt_threads = max(thread::hardware_concurrency(), 1u);
+        string record_path;
+        string check_path;
+        double tolerance = 0.25;
+    };
+
+    /**
+    * @brief Throughput of a single phase.
+    */
+    struct measurement {
+        string phase;
+        double seconds;
+        double items_per_second;
+        double megabytes_per_second;
+    };
+
+    vector<measurement> measurements;
+
+    constexpr double MIN_COMPARED_SECONDS = 0.01;
+
+    bench_options parse_arguments(int argc, char *argv[]) {
+        bench_options parsed;
+
+        for (int i = 1; i < argc; i++) {
+            string argument = argv[i];
+            if (argument == "--repeat" && i + 1 < argc)
+                parsed.cnt_repeats = max(stoi(argv[++i]), 1);
+            else if (argument == "--threads" && i + 1 < argc)
+                parsed.cnt_threads = static_cast<unsigned>(max(stoi(argv[++i]), 1));
+            else if (argument == "--record" && i + 1 < argc)
+                parsed.record_path = argv[++i];
+            else if (argument == "--check" && i + 1 < argc)
+                parsed.check_path = argv[++i];
+            else if (argument == "--tolerance" && i + 1 < argc)
+                parsed.tolerance = stod(argv[++i]);
+            else if (argument[0] != '-' && parsed.path.empty())
+                parsed.path = argument;
+            else
+                throw invalid_argument("unexpected argument " + argument);
+        }
+
+        if (parsed.path.empty())
+            throw invalid_argument("missing netlist file");
+        if (!parsed.record_path.empty() && !parsed.check_path.empty())
+            throw invalid_argument("--record and --check are mutually exclusive");
+        if (parsed.tolerance < 0 || parsed.tolerance >= 1)
+            throw invalid_argument("tolerance has to be in [0, 1)");
+        return parsed;
+    }
+
+    /**
+    * @brief Returns value in kilobytes of given field (like "VmHWM:") of /proc/self/status, -1 if it cannot
+    * be read.
+    */
+    long status_kb(const string &field) {
+        ifstream status("/proc/self/status");
+        string line;
+        while (getline(status, line))
+            if (line.compare(0, field.size(), field) == 0)
+                return stol(line.substr(field.size()));
+        return -1;
+    }
+
+    /**
+    * @brief Resets peak resident set size of the process to the current one.
+    *
+    * @return Current resident set size in kilobytes, -1 if the peak cannot be reset.
+    */
+    long reset_peak_rss() {
+        ofstream clear_refs("/proc/self/clear_refs");
+        if (!(clear_refs << "5" << flush))
+            return -1;
+        return status_kb("VmRSS:");
+    }
+
+    /**
+    * @brief Returns peak resident set size in kilobytes since the last reset, or since the start of the process
+    * if it cannot be reset.
+    */
+    long peak_rss_kb() {
+        long peak = status_kb("VmHWM:");
+        if (peak >= 0)
+            return peak;
+        struct rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+        return usage.ru_maxrss;
+    }
+
+    /**
+    * Fastest of the runs of a phase, and memory the runs took.
+    */
+    struct phase_runs {
+        double seconds = numeric_limits<double>::max();
+        long peak_rss_kb = 0;
+        long growth_kb = -1; /**< Largest growth of the peak over RSS at the start of a run, -1 if unknown. */
+    };
+
+    /**
+    * @brief Runs the phase given number of times, each time after preparing its inputs, which is neither timed
+    * nor counted in the peak resident set size.
+    */
+    template<typename Prepare, typename Phase>
+    phase_runs fastest_run(int cnt_repeats, Prepare prepare, Phase phase) {
+        phase_runs runs;
+
+        for (int i = 0; i < cnt_repeats; i++) {
+            prepare();
+            long start_rss = reset_peak_rss();
+            auto start = chrono::steady_clock::now();
+            phase();
+            chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+            long peak = peak_rss_kb();
+            runs.seconds = min(runs.seconds, elapsed.count());
+            runs.peak_rss_kb = max(runs.peak_rss_kb, peak);
+            if (start_rss >= 0)
+                runs.growth_kb = max(runs.growth_kb, peak - start_rss);
+        }
+        return runs;
+    }
+
+    template<typename Phase>
+    phase_runs fastest_run(int cnt_repeats, Phase phase) {
+        return fastest_run(cnt_repeats, []() {}, phase);
+    }
+
+    /**
+    * @brief Prints throughput of the phase: items and bytes (read or written) per second, and remembers it.
+    */
+    void report(const string &phase, size_t cnt_items, const string &items, size_t cnt_bytes, const phase_runs &runs) {
+        double seconds = runs.seconds;
+        measurements.push_back({phase, seconds, cnt_items / seconds, cnt_bytes / seconds / 1e6});
+        cout << left << setw(28) << phase << right << fixed << setprecision(3)
+             << setw(9) << seconds << " s" << setw(14) << static_cast<long>(cnt_items / seconds) << " " << items << "/s"
+             << setw(8) << setprecision(1) << cnt_bytes / seconds / 1e6 << " MB/s"
+             << "   peak RSS " << runs.peak_rss_kb << " KB";
+        if (runs.growth_kb >= 0)
+            cout << " (+" << runs.growth_kb << " KB)";
+        else
+            cout << " (lifetime peak)";
+        cout << endl;
+    }
+
+    /**
+    * @brief Writes measurements to the baseline file, one phase per line: seconds, items/s, MB/s and name
+    * of the phase.
+    *
+    * @throws runtime_error if the file cannot be written.
+    */
+    void record_baseline(const string &path) {
+        ofstream file(path);
+        for (const measurement &m : measurements)
+            file << fixed << setprecision(4) << m.seconds << '\t' << setprecision(1) << m.items_per_second << '\t'
+                 << m.megabytes_per_second << '\t' << m.phase << '\n';
+        if (!file.flush())
+            throw runtime_error("Cannot write baseline " + path);
+    }
+
+    /**
+    * @brief Compares measurements with the baseline file; phases missing on either side or too short
+    * to be compared are skipped.
+    *
+    * @return Number of phases slower than the baseline by more than the tolerance.
+    * @throws runtime_error if the file cannot be read or is malformed.
+    */
+    int check_baseline(const string &path, double tolerance) {
+        ifstream file(path);
+        if (!file)
+            throw runtime_error("Cannot open baseline " + path);
+
+        int cnt_regressions = 0;
+        string line;
+        while (getline(file, line)) {
+            if (line.empty() || line[0] == '#')
+                continue;
+
+            istringstream iss(line);
+            measurement recorded;
+            if (!(iss >> recorded.seconds >> recorded.items_per_second >> recorded.megabytes_per_second)
+                || !getline(iss >> ws, recorded.phase))
+                throw runtime_error("Malformed baseline line: " + line);
+
+            auto current = find_if(measurements.begin(), measurements.end(),
+                                   [&recorded](const measurement &m) { return m.phase == recorded.phase; });
+            if (current == measurements.end() || recorded.seconds < MIN_COMPARED_SECONDS)
+                continue;
+
+            double ratio = current->megabytes_per_second / recorded.megabytes_per_second;
+            bool regression = ratio < 1 - tolerance;
+            cnt_regressions += regression;
+            cout << left << setw(28) << recorded.phase << right << fixed << setprecision(1)
+                 << setw(8) << current->megabytes_per_second << " MB/s vs" << setw(8) << recorded.megabytes_per_second
+                 << " MB/s baseline" << setw(8) << setprecision(2) << ratio << "x"
+                 << (regression ? "   REGRESSION" : "") << endl;
+        }
+        return cnt_regressions;
+    }
+}
+
+int main(int argc, char *argv[]) {
+    bench_options options;
+
+    try {
+        options = parse_arguments(argc, argv);
+    } catch (logic_error &e) {
+        cerr << e.what() << endl << USAGE << endl;
+        return 1;
+    }
+
+    string contents;
+    try {
+        parallel_reader::mapped_file file(options.path);
+        contents = string(file.contents());
+    } catch (runtime_error &e) {
+        cerr << e.what() << endl;
+        return 1;
+    }
+    size_t cnt_lines = static_cast<size_t>(count(contents.begin(), contents.end(), '\n'));
+    cout << options.path << ": " << cnt_lines << " lines, " << contents.size() << " bytes" << endl;
+
+    vector<string_view> lines;
+    for (size_t begin = 0, end; begin < contents.size(); begin = end + 1) {
+        end = min(contents.find('\n', begin), contents.size());
+        lines.push_back(string_view(contents).substr(begin, end - begin));
+    }
+
+    const pair<scanner::simd_level, const char *> levels[] = {{scanner::simd_level::scalar, "scan_line (scalar)"},
+                                                              {scanner::simd_level::sse42,  "scan_line (SSE4.2)"},
+                                                              {scanner::simd_level::avx2,   "scan_line (AVX2)"}};
+    size_t cnt_elements = 0;
+    for (const auto &level : levels) {
+        if (level.first > scanner::detected_simd_level())
+            continue;
+        scanner::active_simd_level() = level.first;
+        report(level.second, lines.size(), "lines", contents.size(), fastest_run(options.cnt_repeats, [&]() {
+            scanner::element_tokens tokens;
+            cnt_elements = 0;
+            for (string_view line : lines)
+                cnt_elements += (scanner::scan_line(line, tokens) == scanner::line_kind::element);
+        }));
+    }
+    scanner::active_simd_level() = scanner::detected_simd_level();
+
+    circuit_structures::circuit data;
+    ostringstream errors;
+    istringstream input;
+    auto prepare_reading = [&]() {
+        data = circuit_structures::circuit();
+        errors.str("");
+    };
+    report("reader::read_data", cnt_lines, "lines", contents.size(), fastest_run(options.cnt_repeats, [&]() {
+        prepare_reading();
+        input.clear();
+        input.str(contents);
+    }, [&]() {
+        data = reader::read_data(input, errors);
+    }));
+    input.str(string());
+    report("parallel_reader::read_file", cnt_lines, "lines", contents.size(),
+           fastest_run(options.cnt_repeats, prepare_reading, [&]() {
+               data = parallel_reader::read_file(options.path, options.cnt_threads, errors);
+           }));
+
+    size_t cnt_items_bytes = 0, cnt_warnings_bytes = 0;
+    phase_runs runs = fastest_run(options.cnt_repeats, [&]() {
+        cnt_items_bytes = writer::format_all_items(data.view(), options.cnt_threads).size();
+    });
+    report("writer::format_all_items", data.elements.size(), "elements", cnt_items_bytes, runs);
+    runs = fastest_run(options.cnt_repeats, [&]() {
+        cnt_warnings_bytes = writer::format_warnings(writer::unconnected_nodes(data.cnt_nodes_plugs)).size();
+    });
+    report("writer::format_warnings", data.cnt_nodes_plugs.size(), "nodes", cnt_warnings_bytes, runs);
+
+    cout << data.elements.size() << " elements, " << data.types.size() << " types, "
+         << data.cnt_nodes_plugs.size() << " nodes" << endl;
+
+    try {
+        if (!options.record_path.empty())
+            record_baseline(options.record_path);
+        if (!options.check_path.empty() && check_baseline(options.check_path, options.tolerance) > 0)
+            return 1;
+    } catch (runtime_error &e) {
+        cerr << e.what() << endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,208 @@
+/*
+  Fuzz target of obwody's readers. Every input is a netlist: each of its lines is judged by the reference,
+  regular expressions based reader::parse_line and by scanner::scan_line at every level of vectorization
+  the processor supports, and the whole netlist is read by reader::read_data, whose errors are compared
+  with the reference model of obwody_reference.h. The list of elements, errors and warnings printed
+  for the circuit read by reader::read_data are then compared with those of every other reader, given
+  the netlist in a temporary file: parallel_reader::read_file (with a number of threads depending on
+  the input, so chunk boundaries fall in many places), batch::process_netlist (with a worker state
+  reused between inputs) and external::run (with a budget so small that every record is spilled
+  and runs are merged in several passes). Any difference aborts.
+
+  libFuzzer:  clang++ -O1 -g -std=c++17 -pthread -fsanitize=fuzzer,address -DOBWODY_LIBFUZZER \
+                      obwody_fuzz.cc -o obwody_fuzz && ./obwody_fuzz CORPUS_DIR
+  standalone: g++ -Wall -Wextra -O2 -std=c++17 -pthread obwody_fuzz.cc -o obwody_fuzz
+              ./obwody_fuzz [--runs N] [--seed S] [FILE...]
+  Standalone, given files are run as inputs, otherwise N random netlists are generated from seed S.
+*/
+
+#define OBWODY_NO_MAIN
+#include "src/obwody.cc"
+#include "obwody_reference.h"
+
+#include <cstdlib>
+
+namespace {
+
+    constexpr unsigned MAX_THREADS = 7; /**< parallel_reader::read_file runs with 1 to MAX_THREADS threads. */
+    constexpr size_t EXTERNAL_BUDGET = 1; /**< Memory budget of external::run, forcing a spill per record. */
+
+    void fail(const string &what, string_view line) {
+        cerr << "Mismatch (" << what << ") on line: \"" << line << "\"" << endl;
+        abort();
+    }
+
+    /**
+    * @brief Checks every scanner against the reference decision about a single line.
+    */
+    void check_line(const string &line, scanner::line_kind expected) {
+        scanner::element_tokens tokens;
+
+        if (scanner::scan_line_scalar(line, tokens) != expected
+            || (expected == scanner::line_kind::element && !reference::same_tokens(line, tokens)))
+            fail("scalar scanner", line);
+
+        for (scanner::simd_level level : {scanner::simd_level::sse42, scanner::simd_level::avx2}) {
+            if (level > scanner::detected_simd_level() || line.size() >= scanner::SIMD_LINE)
+                continue;
+            if (scanner::scan_line_simd(line, tokens, level) != expected
+                || (expected == scanner::line_kind::element && !reference::same_tokens(line, tokens)))
+                fail("vectorized scanner", line);
+        }
+    }
+
+    /**
+    * Netlist written to a temporary file in $TMPDIR (or /tmp), removed on destruction.
+    */
+    class netlist_file {
+    private:
+        string file_path;
+
+    public:
+        explicit netlist_file(const string &netlist) {
+            const char *directory = getenv("TMPDIR");
+            file_path = string(directory != nullptr && *directory != '\0' ? directory : "/tmp") + "/obwody_fuzzXXXXXX";
+            int fd = mkstemp(&file_path[0]);
+            if (fd < 0)
+                throw runtime_error("Cannot create temporary file " + file_path + ": " + strerror(errno));
+            bool written = write(fd, netlist.data(), netlist.size()) == static_cast<ssize_t>(netlist.size());
+            close(fd);
+            if (!written) {
+                unlink(file_path.c_str());
+                throw runtime_error("Cannot write temporary file " + file_path);
+            }
+        }
+
+        netlist_file(const netlist_file &) = delete;
+        netlist_file &operator=(const netlist_file &) = delete;
+
+        ~netlist_file() {
+            unlink(file_path.c_str());
+        }
+
+        const string &path() const {
+            return file_path;
+        }
+    };
+
+    /**
+    * Standard output and error redirected to strings for the lifetime of the object.
+    */
+    class captured_output {
+    private:
+        ostringstream captured_out, captured_err;
+        streambuf *old_out, *old_err;
+
+    public:
+        captured_output() : old_out(cout.rdbuf(captured_out.rdbuf())), old_err(cerr.rdbuf(captured_err.rdbuf())) {}
+
+        captured_output(const captured_output &) = delete;
+        captured_output &operator=(const captured_output &) = delete;
+
+        ~captured_output() {
+            cout.rdbuf(old_out);
+            cerr.rdbuf(old_err);
+        }
+
+        string out() const {
+            return captured_out.str();
+        }
+
+        string err() const {
+            return captured_err.str();
+        }
+    };
+
+    /**
+    * @brief Returns what obwody prints for the circuit: the list of elements and, separately, errors
+    * followed by the warning.
+    */
+    pair<string, string> printed(const circuit_structures::circuit &data, const string &errors) {
+        return {writer::format_all_items(data.view()),
+                errors + writer::format_warnings(writer::unconnected_nodes(data.cnt_nodes_plugs))};
+    }
+
+    void compare(const string &reader_name, const pair<string, string> &expected, const pair<string, string> &output,
+                 const string &netlist) {
+        if (output.first != expected.first)
+            fail(reader_name + " list of elements", netlist);
+        if (output.second != expected.second)
+            fail(reader_name + " errors and warnings", netlist);
+    }
+
+    /**
+    * @brief Checks the netlist line by line and as a whole: errors of reader::read_data() have to be
+    * those of the reference model, and every other reader has to print exactly what is printed
+    * for the circuit read by reader::read_data().
+    */
+    void check_netlist(const string &netlist) {
+        string expected_errors = reference::netlist_errors(netlist, check_line);
+
+        istringstream input(netlist);
+        ostringstream errors;
+        circuit_structures::circuit data = reader::read_data(input, errors);
+        if (errors.str() != expected_errors)
+            fail("read_data errors", netlist);
+        pair<string, string> expected = printed(data, errors.str());
+
+        netlist_file file(netlist);
+
+        errors.str("");
+        unsigned cnt_threads = 1 + static_cast<unsigned>(netlist.size() % MAX_THREADS);
+        data = parallel_reader::read_file(file.path(), cnt_threads, errors);
+        compare("parallel_reader::read_file", expected, printed(data, errors.str()), netlist);
+
+        static batch::worker_state state;
+        batch::process_netlist(file.path(), state, false);
+        compare("batch::process_netlist", expected, {state.items, state.errors}, netlist);
+
+        pair<string, string> external_output;
+        {
+            captured_output captured;
+            external::run(file.path(), EXTERNAL_BUDGET);
+            external_output = {captured.out(), captured.err()};
+        }
+        compare("external::run", expected, external_output, netlist);
+    }
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+    check_netlist(string(reinterpret_cast<const char *>(data), size));
+    return 0;
+}
+
+#ifndef OBWODY_LIBFUZZER
+int main(int argc, char *argv[]) {
+    unsigned long cnt_runs = 20000, seed = 2018;
+    vector<string> paths;
+
+    for (int i = 1; i < argc; i++) {
+        string argument = argv[i];
+        if (argument == "--runs" && i + 1 < argc)
+            cnt_runs = stoul(argv[++i]);
+        else if (argument == "--seed" && i + 1 < argc)
+            seed = stoul(argv[++i]);
+        else
+            paths.push_back(argument);
+    }
+
+    if (!paths.empty()) {
+        for (const string &path : paths) {
+            ifstream file(path, ios::binary);
+            if (!file) {
+                cerr << "Cannot open file " << path << endl;
+                return 1;
+            }
+            check_netlist(string(istreambuf_iterator<char>(file), istreambuf_iterator<char>()));
+        }
+        cout << "OK, " << paths.size() << " input(s)" << endl;
+        return 0;
+    }
+
+    mt19937 generator(static_cast<mt19937::result_type>(seed));
+    for (unsigned long run = 0; run < cnt_runs; run++)
+        check_netlist(reference::random_netlist(generator));
+    cout << "OK, " << cnt_runs << " random netlists" << endl;
+    return 0;
+}
+#endif
@@ -0,0 +1,153 @@
+/*
+  Generator of synthetic netlists for obwody benchmarks.
+
+  g++ -Wall -Wextra -O2 -std=c++17 obwody_generator.cc -o obwody_generator
+  ./obwody_generator [--elements N] [--label-weights T,D,R,C,E] [--types K] [--nodes M]
+                     [--error-rate P] [--seed S] > netlist.in
+
+  Every element gets a distinct tag, one of K types of its label and terminals plugged into random
+  nodes out of M. With probability P a line is made incorrect instead: its tag repeats an earlier one,
+  all its terminals go to one node or its syntax is broken, in equal proportions.
+*/
+
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+    const char LABELS[] = {'T', 'D', 'R', 'C', 'E'};
+    constexpr size_t CNT_LABELS = sizeof(LABELS);
+    const char *const USAGE = "Usage: obwody_generator [--elements N] [--label-weights T,D,R,C,E] [--types K] "
+                              "[--nodes M] [--error-rate P] [--seed S]";
+
+    struct generator_options {
+        unsigned long cnt_elements = 1000000;
+        vector<double> label_weights = {1, 2, 6, 4, 1};
+        unsigned long cnt_types = 1000;
+        unsigned long cnt_nodes = 200000;
+        double error_rate = 0.01;
+        unsigned long seed = 2018;
+    };
+
+    /**
+    * @brief Parses comma separated list of label weights.
+    *
+    * @throws invalid_argument if the list does not contain exactly one weight per label.
+    */
+    vector<double> parse_weights(const string &list) {
+        vector<double> weights;
+        size_t begin = 0;
+
+        while (begin <= list.size()) {
+            size_t end = list.find(',', begin);
+            if (end == string::npos)
+                end = list.size();
+            weights.push_back(stod(list.substr(begin, end - begin)));
+            begin = end + 1;
+        }
+
+        if (weights.size() != CNT_LABELS)
+            throw invalid_argument("expected one weight per label T, D, R, C, E");
+        return weights;
+    }
+
+    generator_options parse_arguments(int argc, char *argv[]) {
+        generator_options parsed;
+
+        for (int i = 1; i < argc; i++) {
+            string argument = argv[i];
+            if (i + 1 == argc)
+                throw invalid_argument("missing value of " + argument);
+
+            string value = argv[++i];
+            if (argument == "--elements")
+                parsed.cnt_elements = stoul(value);
+            else if (argument == "--label-weights")
+                parsed.label_weights = parse_weights(value);
+            else if (argument == "--types")
+                parsed.cnt_types = max(stoul(value), 1ul);
+            else if (argument == "--nodes")
+                parsed.cnt_nodes = max(stoul(value), 2ul);
+            else if (argument == "--error-rate")
+                parsed.error_rate = stod(value);
+            else if (argument == "--seed")
+                parsed.seed = stoul(value);
+            else
+                throw invalid_argument("unexpected argument " + argument);
+        }
+
+        return parsed;
+    }
+
+    /**
+    * @brief Returns k-th type, types of different labels look differently.
+    */
+    string type_name(char label, unsigned long k) {
+        switch (label) {
+            case 'T':
+                return "BC" + to_string(100 + k);
+            case 'D':
+                return "1N" + to_string(4000 + k);
+            case 'R':
+                return to_string(k + 1) + "k/0,125W";
+            case 'C':
+                return to_string(k + 1) + "uF/6,3V";
+            default:
+                return to_string(k + 1) + "V";
+        }
+    }
+
+    void generate(const generator_options &options, ostream &output) {
+        mt19937_64 generator(options.seed);
+        discrete_distribution<size_t> pick_label(options.label_weights.begin(), options.label_weights.end());
+        uniform_int_distribution<unsigned long> pick_type(0, options.cnt_types - 1);
+        uniform_int_distribution<unsigned long> pick_node(0, options.cnt_nodes - 1);
+        uniform_real_distribution<double> pick_error(0, 1);
+        vector<unsigned long> cnt_tags(CNT_LABELS, 0);
+        string line;
+
+        for (unsigned long i = 0; i < options.cnt_elements; i++) {
+            size_t label = pick_label(generator);
+            int cnt_terminals = (LABELS[label] == 'T' ? 3 : 2);
+            bool error = pick_error(generator) < options.error_rate;
+            int error_kind = static_cast<int>(generator() % 3);
+
+            unsigned long number = cnt_tags[label];
+            if (error && error_kind == 0 && number > 0)
+                number = generator() % number;
+            else
+                cnt_tags[label]++;
+
+            line = LABELS[label] + to_string(number) + " " + type_name(LABELS[label], pick_type(generator));
+            unsigned long node = pick_node(generator);
+            for (int j = 0; j < cnt_terminals; j++) {
+                line += ' ';
+                line += to_string(error && error_kind == 1 ? node : pick_node(generator));
+            }
+            if (error && error_kind == 2)
+                line += " !";
+
+            line += '\n';
+            output << line;
+        }
+    }
+}
+
+int main(int argc, char *argv[]) {
+    generator_options options;
+
+    try {
+        options = parse_arguments(argc, argv);
+    } catch (logic_error &e) {
+        cerr << e.what() << endl << USAGE << endl;
+        return 1;
+    }
+
+    ios_base::sync_with_stdio(false);
+    generate(options, cout);
+    return 0;
+}
@@ -0,0 +1,132 @@
+/*
+  Reference model of obwody's reader, shared by obwody_test.cc and obwody_fuzz.cc, which include it after
+  src/obwody.cc: decisions of the regular expressions based reader::parse_line, tokens read with istringstream,
+  errors of a whole netlist, and generators of lines close to, but not always, correct element descriptions.
+*/
+
+#ifndef OBWODY_REFERENCE_H
+#define OBWODY_REFERENCE_H
+
+#include <random>
+#include <set>
+
+namespace reference {
+
+    /**
+    * @brief Returns regular expressions of correct lines, created once.
+    */
+    inline list<regex> &elements_data_regex() {
+        static list<regex> created = reader::create_regex_for_elements_data();
+        return created;
+    }
+
+    /**
+    * @brief Returns decision of the reference reader about the line.
+    */
+    inline scanner::line_kind line_kind(const string &line) {
+        static const regex empty_string_regex("^$");
+        try {
+            return reader::parse_line(line, 1, elements_data_regex(), empty_string_regex).empty()
+                   ? scanner::line_kind::empty : scanner::line_kind::element;
+        } catch (reader::wrong_input_exception &e) {
+            return scanner::line_kind::malformed;
+        }
+    }
+
+    /**
+    * @brief Determines whether tokens of a correct line are those read from it by istringstream.
+    */
+    inline bool same_tokens(const string &line, const scanner::element_tokens &tokens) {
+        istringstream iss(line);
+        string tag, type;
+        int node_id, cnt_nodes = 0;
+
+        iss >> tag >> type;
+        if (tag != tokens.tag || type != tokens.type || stoi(tag.substr(1)) != tokens.tag_number)
+            return false;
+
+        while (iss >> node_id) {
+            if (cnt_nodes == tokens.nodes_count || tokens.nodes[cnt_nodes] != node_id)
+                return false;
+            cnt_nodes++;
+        }
+        return cnt_nodes == tokens.nodes_count;
+    }
+
+    /**
+    * @brief Returns errors the reader has to print for the netlist: every line which is neither empty nor
+    * the first correct description of its tag plugged into at least two distinct nodes.
+    *
+    * @param[in] netlist - whole input, split into lines like getline() splits it.
+    * @param[in] visit_line - called with every line and the reference decision about it.
+    */
+    template<typename Visitor>
+    string netlist_errors(const string &netlist, Visitor visit_line) {
+        istringstream lines(netlist);
+        string line, errors;
+        set<string> tags;
+        int cnt_line = 0;
+
+        while (getline(lines, line)) {
+            cnt_line++;
+            scanner::line_kind kind = line_kind(line);
+            visit_line(line, kind);
+            if (kind == scanner::line_kind::empty)
+                continue;
+
+            bool correct = kind == scanner::line_kind::element;
+            if (correct) {
+                istringstream iss(line);
+                string tag, type;
+                set<int> nodes;
+                int node_id;
+                iss >> tag >> type;
+                while (iss >> node_id)
+                    nodes.insert(node_id);
+                correct = nodes.size() > 1 && tags.insert(tag).second;
+            }
+            if (!correct)
+                errors += reader::wrong_input_exception(line, cnt_line).what() + string("\n");
+        }
+        return errors;
+    }
+
+    inline string netlist_errors(const string &netlist) {
+        return netlist_errors(netlist, [](const string &, scanner::line_kind) {});
+    }
+
+    /**
+    * @brief Generates line composed of fragments which are close to, but not always, correct element descriptions.
+    * Few distinct tags are generated, so that repetitions in netlists are frequent.
+    */
+    inline string random_line(mt19937 &generator) {
+        static const vector<string> separators = {" ", " ", "  ", "\t", "\r", "\v", "", "x"};
+        static const vector<string> tags = {"T", "D", "R", "C", "E", "X", "t", ""};
+        static const vector<string> types = {"BC107", "1uF/6,3V", "1k/0,125W", "a1", ",1", "1N4148", "Z-z", "5V!",
+                                             "1.5k", ""};
+        static const vector<string> numbers = {"0", "1", "2", "3", "00", "01", "42", "999999999", "1000000000",
+                                               "12a", "-3", ""};
+        auto pick = [&generator](const vector<string> &v) {
+            return v[uniform_int_distribution<size_t>(0, v.size() - 1)(generator)];
+        };
+
+        string line = pick(separators) + pick(tags) + pick(numbers) + pick(separators) + pick(types);
+        int cnt_nodes = uniform_int_distribution<int>(0, 4)(generator);
+        for (int i = 0; i < cnt_nodes; i++)
+            line += pick(separators) + pick(numbers);
+        return line + pick(separators);
+    }
+
+    /**
+    * @brief Generates netlist of up to max_lines random lines.
+    */
+    inline string random_netlist(mt19937 &generator, int max_lines = 20) {
+        string netlist;
+        int cnt_lines = uniform_int_distribution<int>(0, max_lines)(generator);
+        for (int i = 0; i < cnt_lines; i++)
+            netlist += random_line(generator) + "\n";
+        return netlist;
+    }
+} // End of namespace reference.
+
+#endif //OBWODY_REFERENCE_H
@@ -0,0 +1,76 @@
+/*
+  Differential tests of obwody's reader: every line is judged both by the reference, regular expressions
+  based path (reader::parse_line + istringstream) and by the hand-written scanner, in its scalar version
+  and in every vectorized version the processor supports; decisions and tokens have to be identical.
+
+  g++ -Wall -Wextra -O2 -std=c++17 -pthread obwody_test.cc -o obwody_test && ./obwody_test
+*/
+
+#define OBWODY_NO_MAIN
+#include "src/obwody.cc"
+#include "obwody_reference.h"
+
+#include <vector>
+
+namespace {
+
+    int cnt_failures = 0;
+
+    /**
+    * @brief Returns levels of vectorization supported by the processor, simd_level::scalar included.
+    */
+    vector<scanner::simd_level> supported_levels() {
+        vector<scanner::simd_level> levels = {scanner::simd_level::scalar};
+        if (scanner::detected_simd_level() >= scanner::simd_level::sse42)
+            levels.push_back(scanner::simd_level::sse42);
+        if (scanner::detected_simd_level() >= scanner::simd_level::avx2)
+            levels.push_back(scanner::simd_level::avx2);
+        return levels;
+    }
+
+    const vector<scanner::simd_level> levels = supported_levels();
+
+    void check_line(const string &line) {
+        scanner::line_kind expected = reference::line_kind(line);
+
+        for (scanner::simd_level level : levels) {
+            scanner::active_simd_level() = level;
+            scanner::element_tokens tokens;
+            scanner::line_kind scanned = scanner::scan_line(line, tokens);
+
+            if (expected != scanned
+                || (scanned == scanner::line_kind::element && !reference::same_tokens(line, tokens))) {
+                cnt_failures++;
+                cout << "Mismatch on line (level " << static_cast<int>(level) << "): \"" << line << "\"" << endl;
+            }
+        }
+    }
+
+    const vector<string> handcrafted_lines = {
+            "", " ", "\t", "E5 5V 0 1", "T1 BC107 0 11 12", "  C1   1uF/6,3V 11 21  ", "\tR1\t1k/0,125W\t12\t1\r",
+            "D2 1N4148 12", "T1 BC107 0 11", "T1 BC107 0 11 12 13", "R01 1k 1 2", "R0 1k 0 1", "R 1k 1 2",
+            "R1234567890 1k 1 2", "R123456789 1k 1 2", "R1 1k 01 2", "R1 1k 1234567890 2", "R1 1k 999999999 0",
+            "R1 k 1 2", "R1 -1k 1 2", "R1 1k! 1 2", "R1 1k 1 2 x", "R1 1k 1 -2", "R1 1k 1 +2", "X1 1k 1 2",
+            "r1 1k 1 2", "R1\v1k\f1\n2", "R1 1k 1 2 ", string("R1 1k 1\0 2", 10), "R1 \xc5\x81 1 2", "R1 1k 12", "R11k 1 2",
+            "R1 A 1 1", "C3 1n 33 33", "T7 N-CH/MOS 5 5 6", "E0 0 0 0", "R1 1.5k 1 2", "R1 1k 1 2\x80",
+            "R123456789 " + string(33, 'A') + " 999999999 123456789", "R123456789 " + string(34, 'A') + " 1 2",
+            "R123456789 " + string(40, 'A') + " 999999999 123456789", string(60, ' ') + "R1 1 1 2",
+            "T999999999 " + string(20, 'z') + "\t0\t100000000\t99999999" + string(7, '\r')
+    };
+}
+
+int main() {
+    for (const string &line : handcrafted_lines)
+        check_line(line);
+
+    mt19937 generator(2018);
+    for (int i = 0; i < 100000; i++)
+        check_line(reference::random_line(generator));
+
+    if (cnt_failures > 0) {
+        cout << cnt_failures << " mismatch(es)" << endl;
+        return 1;
+    }
+    cout << "OK" << endl;
+    return 0;
+}
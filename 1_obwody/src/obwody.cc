@@ -1,392 +1,4708 @@
 /*
   Assumptions / Convention:
-  element_label = {T, D, R, C, E}
+  element_label = {T, D, R, C, E}, see circuit_structures::ELEMENT_KINDS
   element_tag = e.g. E5, R1 etc.
   element_type: e.g. 1uF/6,3V etc.
 
-  unordered_map<char, string_map> elements_labels; Maps: {elements_labels} -> {{elements_tags} -> {elements_types}}
-  unordered_map<string, unordered_map<char, set<string>>> elements_types; Maps: {elements_types} ->
-  {{element_label} -> {elements_tags_of_given_type_and_label}}
-  map<int, int> cnt_nodes_plugs; {nodes_id} -> {#terminals_plugged_in}
+  Circuit is kept in circuit_structures::circuit: types are interned to 32-bit ids, tags are stored as
+  (label, number) pairs and elements live in a flat struct of arrays.
+  node_table cnt_nodes_plugs; {nodes_id} -> {#terminals_plugged_in}
+  Lines are scanned with SSE4.2 or AVX2 when the processor supports them (detected at run time).
+
+  Compilation: g++ -Wall -Wextra -O2 -std=c++17 -pthread obwody.cc -o obwody
+  Usage: obwody [--threads N] [--incremental] [FILE] - reads the circuit from FILE (scanned in parallel)
+  or from standard input. With --incremental the circuit (from FILE, empty by default) is listed and then
+  edited by commands from standard input: "+DESCRIPTION" adds an element, "-TAG" removes one; after every
+  command only the change of the list and changes of unconnected nodes are printed. A new line of the list
+  is printed with '+' ("+R7: 1k"), a line that disappears with '-', and a tag joining or leaving a line
+  as "~R: 1k +R7" or "~R: 1k -R7", so the output of an edit does not grow with the circuit.
+  --save-snapshot writes the read circuit to a binary snapshot, obwody --load-snapshot lists a snapshot
+  directly from its memory mapping, without parsing.
+  --connectivity appends a report of sub-circuits, floating power sources and node fan-out to the list.
+  --stats appends time spent in phases of the run and counters of lines to the standard error,
+  --stats-json writes them to a JSON file instead.
+  --query QUERIES answers queries from a file instead of listing the circuit: "node N" lists elements
+  plugged into node N, "type T" lists elements of type T, one line of answer per query.
+  obwody --diff OLD NEW compares two versions of a circuit: added (+), removed (-), retyped and rewired (~)
+  elements and changed quantities of lines of the list of elements.
+  obwody --hierarchical reads a circuit with subcircuits (".subckt NAME PORTS" ... ".ends", defined before
+  use) and their instances ("X<number> NAME NODES") and prints quantities of its elements per label and type
+  ("LABEL TYPE: N", in order of the list of elements) and the warning about unconnected nodes of the expanded
+  circuit, without expanding instances; with --flatten it prints the expanded circuit as a flat netlist instead.
+  --memory-budget SIZE (e.g. 64M) lists FILE with memory bounded by SIZE instead of the size of the circuit,
+  sorting elements externally in temporary files ($TMPDIR or /tmp); the output is the same.
+  obwody --batch LIST processes every netlist FILE listed in LIST (one path per line) in a single process,
+  on a pool of --threads workers: the list of elements goes to FILE.bom, errors and warnings to FILE.err.
 */
 
 #include <iostream>
-#include <map>
-#include <set>
 #include <unordered_map>
+#include <set>
+#include <algorithm>
+#include <cstdint>
+#include <charconv>
 #include <sstream>
+#include <fstream>
 #include <regex>
 #include <list>
+#include <tuple>
+#include <string_view>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <memory>
+#include <array>
+#include <utility>
+#include <memory_resource>
+#include <deque>
+#include <queue>
+#include <mutex>
+#include <condition_variable>
+#include <cstring>
+#include <fcntl.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 using namespace std;
 
 namespace circuit_structures {
 
-    class cmp_by_string_length {
-    public:
-        bool operator()(const string &a, const string &b) const {
-            if (a.length() < b.length())
-                return true;
-            else if (a.length() > b.length())
-                return false;
-            return a.compare(b) < 0;
-        }
+    /**
+    * Kind of element: the label starting its tag and the number of its terminals.
+    */
+    struct element_kind {
+        char label;
+        int terminals;
     };
 
-    using string_map = map<string, string, cmp_by_string_length>;
-    using mapping_structures = tuple<unordered_map<char, string_map>,
-            unordered_map<string, unordered_map<char, set<string, cmp_by_string_length>>>,
-            map<int, int>>;
-}
+    /**
+    * All kinds of elements, in the order of the list of elements. Adding a kind takes only a new entry.
+    */
+    constexpr element_kind ELEMENT_KINDS[] = {
+            {'T', 3}, // transistor
+            {'D', 2}, // diode
+            {'R', 2}, // resistor
+            {'C', 2}, // condensator
+            {'E', 2}  // power source
+    };
+    constexpr size_t CNT_KINDS = sizeof(ELEMENT_KINDS) / sizeof(ELEMENT_KINDS[0]);
 
+    constexpr int max_terminals() {
+        int terminals = 0;
+        for (const element_kind &kind : ELEMENT_KINDS)
+            terminals = max(terminals, kind.terminals);
+        return terminals;
+    }
 
-namespace reader {
-    using namespace circuit_structures;
-    const string EMPTY_STRING = "";
+    constexpr int MAX_TERMINALS = max_terminals();
+    constexpr uint32_t NO_NODE = UINT32_MAX; /**< Marks unused terminal slots of elements with two terminals. */
 
-    class wrong_input_exception : public exception {
-    private:
-        string message; /**< Error message to be printed. */
+    /**
+    * Kind of element with given label, found by indexing with the label. Unknown labels have no terminals.
+    */
+    struct label_entry {
+        uint8_t rank; /**< Position of the kind in ELEMENT_KINDS. */
+        uint8_t terminals;
+    };
 
-    public:
-        /**
-        * @brief Constructor for wrong_input_exception, concatenates given strings in proper manner
-        * in order to create error message.
-        *
-        * @param[in] incorrect_input - sequence of characters which turned out to be incorrect.
-        * @param[in] line_number - number of the line.
-        */
-        wrong_input_exception(const string &incorrect_input, const int line_number) {
-            this->message = "Error in line " + to_string(line_number) + ": " + incorrect_input;
+    constexpr array<label_entry, 256> make_label_table() {
+        array<label_entry, 256> table{};
+        for (size_t rank = 0; rank < CNT_KINDS; rank++) {
+            const element_kind &kind = ELEMENT_KINDS[rank];
+            table[static_cast<unsigned char>(kind.label)] = {static_cast<uint8_t>(rank),
+                                                             static_cast<uint8_t>(kind.terminals)};
         }
+        return table;
+    }
 
-        const char *what() const noexcept {
-            return this->message.c_str();
+    constexpr array<label_entry, 256> LABEL_TABLE = make_label_table();
+
+    constexpr bool are_kinds_correct() {
+        for (size_t rank = 0; rank < CNT_KINDS; rank++) {
+            const element_kind &kind = ELEMENT_KINDS[rank];
+            if (kind.terminals < 2 || LABEL_TABLE[static_cast<unsigned char>(kind.label)].rank != rank)
+                return false;
         }
-    };
+        return true;
+    }
+    static_assert(are_kinds_correct(), "kinds of elements need distinct labels and at least two terminals");
 
     /**
-    * @brief Determines whether given string matches given regular expression.
-    *
-    * @param[in] s - sequence to check for match.
-    * @param[in] regex_temple - regular expression which is to be matched.
-    * @return True if s matches @p regex_temple, false otherwise.
+    * @brief Returns number of terminals of an element with given label, 0 for unknown labels.
     */
-    bool matches_template(const string &s, const regex &regex_temple) {
-        return regex_match(s, regex_temple);
+    constexpr int terminals_of_label(char label) {
+        return LABEL_TABLE[static_cast<unsigned char>(label)].terminals;
     }
 
     /**
-    * @brief Determines whether given string matches any of regular expressions in the given list.
-    *
-    * @param[in] s - sequence to check for match.
-    * @param[in] regex_list - list of regular expressions which are to be matched.
-    * @return True if @par s matches any regular expression in the given list.
+    * @brief Returns position of the kind with given label in the order of listing, ELEMENT_KINDS.
     */
-    bool matches_any_template(const string &s, list<regex> &regex_list) {
-        for (const auto &reg : regex_list)
-            if (matches_template(s, reg))
-                return true;
-        return false;
+    constexpr uint64_t label_rank(char label) {
+        return LABEL_TABLE[static_cast<unsigned char>(label)].rank;
     }
 
     /**
-    * @brief Creates list of regular expressions that matches correct input.
-    *
-    * @return List of created regular expressions.
+    * @brief Packs element's tag (label, number) into a single integer key.
     */
-    list<regex> create_regex_for_elements_data() {
-        list <regex> l;
-        const regex transistor_regex(
-                R"(\s*[T](0|[1-9]{1}\d{0,8})\s+([A-Z]|\d)([A-Za-z0-9]|[,\-\/])*(\s+(0|[1-9]{1}\d{0,8})){3}\s*)");
-        const regex other_elements_regex(
-                R"(\s*[DRCE](0|[1-9]{1}\d{0,8})\s+([A-Z]|\d)([A-Za-z0-9]|[,\-\/])*(\s+(0|[1-9]{1}\d{0,8})){2}\s*)");
-
-        l.push_back(transistor_regex);
-        l.push_back(other_elements_regex);
-
-        return l;
+    inline uint64_t tag_key(char label, uint32_t number) {
+        return (static_cast<uint64_t>(static_cast<unsigned char>(label)) << 32) | number;
     }
 
     /**
-    * @brief Increases (+1) counter of terminals plugged in the given node.
-    *
-    * @param[in, out] cnt_nodes_plugs - structure containing counters for every node in the circuit.
-    * @param[in] node_id - id of node whose counter is to be increased.
+    * Allocator drawing memory from a memory resource, normally the arena of a circuit. Unlike
+    * pmr::polymorphic_allocator it moves together with the container, so circuits can be moved
+    * (and move assigned) in O(1) along with their arenas.
     */
-    void update_nodes_plugs(map<int, int> &cnt_nodes_plugs, int node_id) {
-        cnt_nodes_plugs[node_id]++;
-    }
+    template<typename T>
+    class arena_allocator {
+    public:
+        using value_type = T;
+        using propagate_on_container_copy_assignment = true_type;
+        using propagate_on_container_move_assignment = true_type;
+        using propagate_on_container_swap = true_type;
+
+        pmr::memory_resource *resource;
+
+        explicit arena_allocator(pmr::memory_resource *resource = pmr::get_default_resource()) noexcept
+                : resource(resource) {}
+
+        template<typename U>
+        arena_allocator(const arena_allocator<U> &other) noexcept : resource(other.resource) {}
+
+        T *allocate(size_t n) {
+            return static_cast<T *>(resource->allocate(n * sizeof(T), alignof(T)));
+        }
+
+        void deallocate(T *pointer, size_t n) noexcept {
+            resource->deallocate(pointer, n * sizeof(T), alignof(T));
+        }
+
+        template<typename U>
+        bool operator==(const arena_allocator<U> &other) const noexcept {
+            return resource == other.resource;
+        }
+
+        template<typename U>
+        bool operator!=(const arena_allocator<U> &other) const noexcept {
+            return resource != other.resource;
+        }
+    };
+
+    template<typename Key, typename Value>
+    using arena_hash_map = unordered_map<Key, Value, hash<Key>, equal_to<Key>,
+                                         arena_allocator<pair<const Key, Value>>>;
+
+    template<typename Key, typename Value>
+    using arena_hash_multimap = unordered_multimap<Key, Value, hash<Key>, equal_to<Key>,
+                                                   arena_allocator<pair<const Key, Value>>>;
 
     /**
-    * @brief Determines whether element with given tag has been already added to dataset.
-    *
-    * @param[in, out] elements_labels - Structure containing mapping:
-    * {elements_labels} -> {{elements_tags} -> {elements_types}}
-    * @param[in] element_tag - tag of element to be checked.
-    * @return True if similar element has been already added to data, false otherwise.
+    * Assigns consecutive 32-bit ids to distinct element types. Every type string is stored once,
+    * all of them one after another in a single buffer.
     */
-    bool is_repetition(unordered_map<char, string_map> &elements_labels, const string &element_tag) {
-        char element_label = element_tag[0];
-        return elements_labels[element_label].count(element_tag) > 0;
-    }
+    class type_interner {
+    private:
+        string chars; /**< Concatenated types. */
+        vector<uint32_t> offsets = {0}; /**< Type with id i occupies chars[offsets[i], offsets[i + 1]). */
+        arena_hash_multimap<size_t, uint32_t> ids; /**< {hash of type} -> {id of type} */
+
+    public:
+        /**
+        * @param[in] arena - memory resource for nodes of the hash table.
+        */
+        explicit type_interner(pmr::memory_resource *arena = pmr::get_default_resource())
+                : ids(arena_allocator<pair<const size_t, uint32_t>>(arena)) {}
+
+        static constexpr uint32_t NO_TYPE = UINT32_MAX;
+
+        /**
+        * @brief Returns id of given type, NO_TYPE if the type has not been interned.
+        */
+        uint32_t find(string_view type, size_t hash_value) const {
+            auto range = ids.equal_range(hash_value);
+            for (auto iterator = range.first; iterator != range.second; ++iterator)
+                if (type_of(iterator->second) == type)
+                    return iterator->second;
+            return NO_TYPE;
+        }
+
+        uint32_t find(string_view type) const {
+            return find(type, hash<string_view>()(type));
+        }
+
+        /**
+        * @brief Returns id of given type, assigning a new one if the type is seen for the first time.
+        */
+        uint32_t intern(string_view type) {
+            size_t hash_value = hash<string_view>()(type);
+            uint32_t id = find(type, hash_value);
+            if (id != NO_TYPE)
+                return id;
+
+            id = static_cast<uint32_t>(size());
+            chars.append(type);
+            offsets.push_back(static_cast<uint32_t>(chars.size()));
+            ids.emplace(hash_value, id);
+            return id;
+        }
+
+        string_view type_of(uint32_t id) const {
+            return string_view(chars).substr(offsets[id], offsets[id + 1] - offsets[id]);
+        }
+
+        size_t size() const {
+            return offsets.size() - 1;
+        }
+
+        const string &all_chars() const {
+            return chars;
+        }
+
+        const vector<uint32_t> &all_offsets() const {
+            return offsets;
+        }
+
+        /**
+        * @brief Forgets all types, keeping buffer of types for the next circuit. Nodes of the hash table
+        * go back to the arena, to be reused by the next circuit.
+        */
+        void clear() {
+            chars.clear();
+            offsets.resize(1);
+            ids = decltype(ids)(ids.get_allocator());
+        }
+    };
 
     /**
-    * @brief Determines whether read data meets given requirements:
-    * Element's tag is not repetition = elements in circuit must be unique.
-    * Element's terminals have to be plugged into at least two different nodes == nodes_connected must
-    * contain at least two elements.
-    *
-    * @param elements_labels - Structure containing mapping:
-    * {elements_labels} -> {{elements_tags} -> {elements_types}}
-    * @param element_tag - tag of element to be checked.
-    * @param nodes_connected - set of nodes to which are connected element's terminals.
-    *
-    * @return True if data meet requirements, false otherwise.
+    * Elements of the circuit kept as a struct of arrays, i-th element is described by i-th entries.
     */
-    bool is_correct_data(unordered_map<char, string_map> &elements_labels, const string &element_tag,
-                         set<int> &nodes_connected) {
-        return !is_repetition(elements_labels, element_tag) && nodes_connected.size() > 1;
-    }
+    struct element_table {
+        vector<char> labels;
+        vector<uint32_t> numbers; /**< Numbers from elements' tags. */
+        vector<uint32_t> types; /**< Ids of elements' types. */
+        vector<uint32_t> terminals; /**< MAX_TERMINALS nodes per element, padded with NO_NODE. */
+
+        size_t size() const {
+            return labels.size();
+        }
+
+        void clear() {
+            labels.clear();
+            numbers.clear();
+            types.clear();
+            terminals.clear();
+        }
+    };
 
     /**
-    * @brief Inserts new element to the mapping structure.
+    * @brief Sorts items by keys below 2^30 with LSD radix sort, three passes of 10 bits each.
+    * The sort is stable, items with equal keys keep their order.
     *
-    * @param[in, out] elements_types - structure containing mapping:
-    * {elements_types} -> {{element_label} -> {elements_tags_of_given_type_and_label}}
-    * @param[in] element_type - type of given element.
-    * @param[in] element_tag - tag of given element.
+    * @param[in, out] items - items to be sorted.
+    * @param[in] key - function returning the key of an item.
     */
-    void insert_new_element_type_mapping(
-            unordered_map<string, unordered_map<char, set<string, cmp_by_string_length>>> &elements_types,
-            const string &element_type, const string &element_tag) {
-        char element_label = element_tag[0];
-        elements_types[element_type][element_label].insert(element_tag);
+    template<typename T, typename Key>
+    void radix_sort(vector<T> &items, Key key) {
+        constexpr int DIGIT_BITS = 10;
+        constexpr uint32_t DIGIT_MASK = (1u << DIGIT_BITS) - 1;
+        vector<T> buffer(items.size());
+
+        for (int shift = 0; shift < 3 * DIGIT_BITS; shift += DIGIT_BITS) {
+            vector<size_t> positions(DIGIT_MASK + 2, 0);
+            for (const T &item : items)
+                positions[((key(item) >> shift) & DIGIT_MASK) + 1]++;
+            for (size_t digit = 1; digit < positions.size(); digit++)
+                positions[digit] += positions[digit - 1];
+            for (const T &item : items)
+                buffer[positions[(key(item) >> shift) & DIGIT_MASK]++] = item;
+            items.swap(buffer);
+        }
     }
 
     /**
-    * @brief Inserts new element to the mapping structue.
+    * @brief Sorts numbers below 2^30 with LSD radix sort, three passes of 10 bits each.
     *
-    * @param[in, out] elements_labels - Structure containing mapping:
-    * {elements_labels} -> {{elements_tags} -> {elements_types}}
-    * @param[in] element_type - type of given element.
-    * @param[in] element_tag - tag of given element.
+    * @param[in, out] numbers - numbers to be sorted.
     */
-    void insert_new_element_label_mapping(unordered_map<char, string_map> &elements_labels,
-                                          const string &element_type, const string &element_tag) {
-        char element_label = element_tag[0];
-        elements_labels[element_label][element_tag] = element_type;
+    void radix_sort(vector<uint32_t> &numbers) {
+        radix_sort(numbers, [](uint32_t number) { return number; });
     }
 
+    constexpr size_t PARALLEL_GRAIN = 1 << 16; /**< Smallest number of items worth a separate thread. */
+
     /**
-    * @brief Parses correct element description and adds necessary data to mapping structures.
-    * Assumption: element_description is correct description of some element: template-wise.
-    * Although element might be repetition, or list of nodes might contain repetitions, therefore
-    * it might still be incorrect.
+    * @brief Sorts range with given number of threads: pieces of the range are sorted in parallel,
+    * then merged pairwise, also in parallel.
     *
-    * @throws wrong_input_exception if line contains input inconsistent with presumptions.
-    * @param[in, out] circuit_data - Tuple containing mapping structures which contain loaded data.
-    * @param[in] element_description - line describing new elemnt to be added.
-    * @param[in] cnt_line - parsed lines counter.
+    * @param[in, out] begin - beginning of the range.
+    * @param[in, out] end - end of the range.
+    * @param[in] cnt_threads - number of threads to use.
     */
-    void parse_element_description(mapping_structures &circuit_data, string &element_description, int cnt_line) {
-        string element_tag, element_type;
-        set<int> nodes_connected;
-        int node_id;
-        istringstream iss; iss.clear();
-        iss.str(element_description);
+    template<typename T>
+    void parallel_sort(T *begin, T *end, unsigned cnt_threads) {
+        auto size = static_cast<size_t>(end - begin);
+        size_t cnt_pieces = min<size_t>(max(cnt_threads, 1u), size / PARALLEL_GRAIN + 1);
+        if (cnt_pieces == 1) {
+            sort(begin, end);
+            return;
+        }
 
-        iss >> element_tag >> element_type;
-        while (iss >> node_id)
-            nodes_connected.insert(node_id);
+        vector<T *> bounds(cnt_pieces + 1);
+        for (size_t piece = 0; piece <= cnt_pieces; piece++)
+            bounds[piece] = begin + size * piece / cnt_pieces;
 
-        if (is_correct_data(get<0>(circuit_data), element_tag, nodes_connected)) {
-            insert_new_element_type_mapping(get<1>(circuit_data), element_type, element_tag);
-            insert_new_element_label_mapping(get<0>(circuit_data), element_type, element_tag);
+        vector<thread> workers;
+        for (size_t piece = 1; piece < cnt_pieces; piece++)
+            workers.emplace_back([&bounds, piece]() { sort(bounds[piece], bounds[piece + 1]); });
+        sort(bounds[0], bounds[1]);
+        for (thread &worker : workers)
+            worker.join();
 
-            for (int node_id : nodes_connected)
-                update_nodes_plugs(get<2>(circuit_data), node_id);
-        } else {
-            throw wrong_input_exception(element_description, cnt_line);
+        for (size_t width = 1; width < cnt_pieces; width *= 2) {
+            workers.clear();
+            for (size_t piece = 0; piece + width < cnt_pieces; piece += 2 * width) {
+                T *first = bounds[piece], *middle = bounds[piece + width];
+                T *last = bounds[min(piece + 2 * width, cnt_pieces)];
+                workers.emplace_back([first, middle, last]() { inplace_merge(first, middle, last); });
+            }
+            for (thread &worker : workers)
+                worker.join();
         }
     }
 
     /**
-    * @brief String is considered "white" when it's empty or composed only of white characters.
-    *
-    * @throws wrong_input_exception if line contains input inconsistent with presumptions.
-    * @param[in] line - line to be parsed.
-    * @param[in] cnt_line - parsed lines counter.
-    * @return EMPTY_STRING if line was incorrect, empty or "white".
-    * Otherwise string following given template: ELEMENT_TOKEN ELEMENT_TYPE LIST_OF_NODES_CONNECTED_TO_IT'S_TERMINALS
+    * Counters of terminals plugged into nodes, {nodes_id} -> {#terminals_plugged_in}.
+    * While all ids are small the counters are kept in a dense array indexed by id, afterwards
+    * in an open addressing hash table with linear probing. Both give O(1) updates.
     */
-    string parse_line(const string &line, int cnt_line,
-                      list<regex> &elements_data_regex, const regex &empty_string_regex) {
-        if (matches_any_template(line, elements_data_regex))
-            return line;
-        else if (matches_template(line, empty_string_regex))
-            return EMPTY_STRING;
+    class node_table {
+    private:
+        static constexpr uint32_t DENSE_LIMIT = 1u << 20; /**< Ids from which the table switches to hashing. */
+        static constexpr uint32_t EMPTY_KEY = UINT32_MAX;
 
-        throw wrong_input_exception(line, cnt_line);
-    }
+        bool dense = true;
+        vector<uint32_t> keys; /**< Hash mode only: node ids, EMPTY_KEY for free slots. */
+        vector<uint32_t> counts; /**< Counters indexed by id in dense mode, by slot in hash mode. */
+        size_t cnt_nodes = 0;
+        int capacity_bits = 0; /**< Hash mode only: keys.size() == 2^capacity_bits. */
 
-    /**
-    * @brief Returns tuple composed of three mapping structures containing read data: (A, B, C):
-    *
-    * A: unordered_map<char, string_map> elements_labels - u_map where key is element's label and value is string_map
-    * which contains mapping where keys are elements_tags and values are elements_types.
-    * Mapping: {elements_labels} -> {{elements_tags} -> {elements_types}}
-    *
-    * B: unordered_map<string, unordered_map<char, set<string>>> - u_map where key is element type and value is set containing
-    * element's tags of this element type. Mapping: {elements_types} ->
-    * {{element_label} > {elements_tags_of_given_type_and_label}}.
-    *
-    * C: map<int, int> - u_map where key is node's number and value is number of terminals
-    * plugged to that node. Mapping: {nodes_id} -> {#terminals_plugged_in}.
-    *
-    * @return Tuple composed of three mapping structures containing read data: (A, B, C):
-    */
-    mapping_structures read_data() {
-        mapping_structures circuit_data;
-        list<regex> elements_data_regex = create_regex_for_elements_data();
-        const regex empty_string_regex("^$");
+        size_t home_slot(uint32_t node) const {
+            return (node * 0x9E3779B97F4A7C15ull) >> (64 - capacity_bits);
+        }
 
-        string line, element_description;
-        int cnt_line = 0;
-        while (getline(cin, line)) {
-            cnt_line++;
+        size_t slot_of(uint32_t node) const {
+            size_t mask = keys.size() - 1;
+            size_t slot = home_slot(node);
+            while (keys[slot] != node && keys[slot] != EMPTY_KEY)
+                slot = (slot + 1) & mask;
+            return slot;
+        }
 
-            try {
-                element_description = parse_line(line, cnt_line, elements_data_regex, empty_string_regex);
-                if (!element_description.empty())
-                    parse_element_description(circuit_data, element_description, cnt_line);
-            } catch (wrong_input_exception &e) {
-                cerr << e.what() << endl;
+        /**
+        * @brief Moves all counters to a hash table with at least 4 * cnt_nodes slots.
+        */
+        void rehash() {
+            for (capacity_bits = 6; (size_t(1) << capacity_bits) < 4 * cnt_nodes; capacity_bits++);
+            size_t capacity = size_t(1) << capacity_bits;
+            vector<uint32_t> old_keys(capacity, EMPTY_KEY), old_counts(capacity, 0);
+            keys.swap(old_keys);
+            counts.swap(old_counts);
+
+            for (size_t i = 0; i < old_counts.size(); i++) {
+                uint32_t node = dense ? static_cast<uint32_t>(i) : old_keys[i];
+                if (old_counts[i] > 0 && node != EMPTY_KEY) {
+                    size_t slot = slot_of(node);
+                    keys[slot] = node;
+                    counts[slot] = old_counts[i];
+                }
             }
+            dense = false;
         }
 
-        return circuit_data;
-    }
-} // End of namespace reader.
+    public:
+        /**
+        * @brief Increases (+1) counter of terminals plugged in the given node.
+        */
+        void increment(uint32_t node) {
+            if (dense && node >= DENSE_LIMIT)
+                rehash();
 
-namespace writer {
-    using namespace circuit_structures;
+            if (dense) {
+                if (node >= counts.size())
+                    counts.resize(max<size_t>(2 * counts.size(), node + 1), 0);
+                if (counts[node]++ == 0)
+                    cnt_nodes++;
+                return;
+            }
+
+            if (2 * (cnt_nodes + 1) > keys.size())
+                rehash();
+            size_t slot = slot_of(node);
+            if (keys[slot] == EMPTY_KEY) {
+                keys[slot] = node;
+                cnt_nodes++;
+            }
+            counts[slot]++;
+        }
+
+        /**
+        * @brief Decreases (-1) counter of terminals plugged in the given node, forgetting the node
+        * when its counter drops to 0. The node has to be known.
+        */
+        void decrement(uint32_t node) {
+            if (dense) {
+                if (--counts[node] == 0)
+                    cnt_nodes--;
+                return;
+            }
+
+            size_t slot = slot_of(node);
+            if (--counts[slot] > 0)
+                return;
+
+            // Backward shift deletion keeps probe sequences of the remaining keys unbroken.
+            size_t mask = keys.size() - 1;
+            for (size_t next = (slot + 1) & mask; keys[next] != EMPTY_KEY; next = (next + 1) & mask) {
+                size_t home = home_slot(keys[next]);
+                if (((next - home) & mask) >= ((next - slot) & mask)) {
+                    keys[slot] = keys[next];
+                    counts[slot] = counts[next];
+                    slot = next;
+                }
+            }
+            keys[slot] = EMPTY_KEY;
+            counts[slot] = 0;
+            cnt_nodes--;
+        }
+
+        /**
+        * @brief Returns number of terminals plugged in the given node, 0 for unknown nodes.
+        */
+        uint32_t count(uint32_t node) const {
+            if (dense)
+                return node < counts.size() ? counts[node] : 0;
+
+            size_t slot = slot_of(node);
+            return keys[slot] == EMPTY_KEY ? 0 : counts[slot];
+        }
+
+        /**
+        * @brief Returns number of nodes with at least one terminal plugged in.
+        */
+        size_t size() const {
+            return cnt_nodes;
+        }
 
-    enum Element {transistor = 'T', diode = 'D', resistor = 'R', condensator = 'C', power_source = 'E'};
+        /**
+        * @brief Forgets all nodes and returns to the dense mode, keeping allocated memory for the next circuit.
+        */
+        void clear() {
+            dense = true;
+            keys.clear();
+            fill(counts.begin(), counts.end(), 0);
+            cnt_nodes = 0;
+            capacity_bits = 0;
+        }
+
+        /**
+        * @brief Returns sorted ids of known nodes with fewer than given number of terminals plugged in.
+        */
+        vector<uint32_t> sorted_nodes_below(uint32_t min_count) const {
+            vector<uint32_t> nodes;
 
-    using type_map = unordered_map<string, unordered_map<char, set<string, cmp_by_string_length>>>;
+            for (size_t i = 0; i < counts.size(); i++)
+                if (counts[i] > 0 && counts[i] < min_count)
+                    nodes.push_back(dense ? static_cast<uint32_t>(i) : keys[i]);
+
+            if (!dense)
+                radix_sort(nodes);
+            return nodes;
+        }
+    };
 
     /**
-    * @brief Lists all tags in given set in order.
-    *
-    * @param tags[in] - set of element tags.
+    * Read-only view of elements and types of a circuit, layout shared by circuit and binary snapshots.
     */
-    void list_tags_from_set(set<string, cmp_by_string_length> &tags) {
-        bool first_tag = true;
+    struct circuit_view {
+        size_t cnt_elements;
+        const char *labels;
+        const uint32_t *numbers;
+        const uint32_t *types;
+        const uint32_t *terminals; /**< MAX_TERMINALS nodes per element, padded with NO_NODE. */
+        size_t cnt_types;
+        const uint32_t *type_offsets; /**< cnt_types + 1 offsets into type_chars. */
+        const char *type_chars;
 
-        for (const string &tag : tags) {
-            if (first_tag) {
-                cout << tag;
-                first_tag = false;
-            } else {
-                cout << ", " << tag;
-            }
+        string_view type_of(uint32_t id) const {
+            return string_view(type_chars + type_offsets[id], type_offsets[id + 1] - type_offsets[id]);
         }
-    }
+    };
 
     /**
-    * @brief Lists all tags of given type and label and adds the type at the end o line.
-    *
-    * @param element[in] - enum corresponding to particular element label,
-    * @param type[in] - type of elements we want to list,
-    * @param element_types[in,out] - mapping of element types to sets of tag with given type.
+    * Whole data read from the input.
+    * Nodes of hash tables, one per element and one per type, are allocated from the circuit's pooled
+    * arena, so reading does not call malloc for every element and destroying the circuit frees a few
+    * big blocks. Nodes of removed elements return to the pool and are reused by the next insertions,
+    * so an incremental session does not grow with the number of edits. Arrays of elements, types
+    * and nodes stay on the heap, where they can grow in place.
     */
-    void list_tags_of_type_and_label(Element element, const string &type, type_map &element_types) {
-        auto iterator = element_types[type].find(element);
+    struct circuit {
+        unique_ptr<pmr::unsynchronized_pool_resource> arena = make_unique<pmr::unsynchronized_pool_resource>();
+        type_interner types;
+        element_table elements;
+        arena_hash_map<uint64_t, uint32_t> tags; /**< {tag_key} -> {index of element in elements} */
+        node_table cnt_nodes_plugs; /**< {nodes_id} -> {#terminals_plugged_in} */
+
+        circuit() : types(arena.get()), tags(arena_allocator<pair<const uint64_t, uint32_t>>(arena.get())) {}
+        circuit(circuit &&) = default;
+        circuit(const circuit &) = delete;
+        circuit &operator=(const circuit &) = delete;
 
-        if (iterator != element_types[type].end()) {
-            list_tags_from_set(element_types[type][element]);
-            cout << ": " << type << endl;
-            element_types[type].erase(element);
+        /**
+        * @brief Takes over data together with the arena. The old arena is destroyed only after
+        * containers allocated from it have been replaced.
+        */
+        circuit &operator=(circuit &&other) noexcept {
+            types = move(other.types);
+            elements = move(other.elements);
+            tags = move(other.tags);
+            cnt_nodes_plugs = move(other.cnt_nodes_plugs);
+            arena = move(other.arena);
+            return *this;
         }
-    }
+
+        /**
+        * @brief Returns view of the circuit, valid until the circuit is modified.
+        */
+        circuit_view view() const {
+            return {elements.size(), elements.labels.data(), elements.numbers.data(), elements.types.data(),
+                    elements.terminals.data(), types.size(), types.all_offsets().data(), types.all_chars().data()};
+        }
+
+        /**
+        * @brief Removes everything from the circuit, keeping arrays of elements, types and nodes
+        * and blocks of the arena, so that reading the next circuit into it hardly allocates.
+        */
+        void clear() {
+            types.clear();
+            elements.clear();
+            tags = decltype(tags)(tags.get_allocator());
+            cnt_nodes_plugs.clear();
+        }
+    };
+}
+
+
+namespace scanner {
+    using circuit_structures::MAX_TERMINALS;
+    using circuit_structures::terminals_of_label;
+
+    constexpr size_t MAX_NUMBER_DIGITS = 9;
+
+    enum class line_kind {element, empty, malformed};
 
     /**
-    * @brief Lists all elements of given label.
-    *
-    * @param element_label[in] - enum corresponding to particular element label,
-    * @param data[in,out] - tuple containing data concerning the circuit.
+    * Tokens of a syntactically correct element line. Views point into the scanned line,
+    * so they are valid only as long as the line itself.
+    */
+    struct element_tokens {
+        string_view tag;
+        int tag_number;
+        string_view type;
+        int nodes[MAX_TERMINALS];
+        int nodes_count;
+    };
+
+    /**
+    * @brief Determines whether given character is white, exactly as `\s` of std::regex
+    * and operator>> of istringstream do in the "C" locale.
     */
-    void list_element_items(Element element_label, mapping_structures &data) {
-        string_map elements_of_type = get<0>(data)[element_label];
+    inline bool is_space(char c) {
+        return c == ' ' || (c >= '\t' && c <= '\r');
+    }
+
+    inline bool is_digit(char c) {
+        return c >= '0' && c <= '9';
+    }
+
+    inline bool is_upper(char c) {
+        return c >= 'A' && c <= 'Z';
+    }
 
-        for (pair<string, string> element : elements_of_type)
-            list_tags_of_type_and_label(element_label, element.second, get<1>(data));
+    inline bool is_type_char(char c) {
+        return is_digit(c) || is_upper(c) || (c >= 'a' && c <= 'z') || c == ',' || c == '-' || c == '/';
     }
 
     /**
-    * @brief Adds node number 0 to the map of nodes in the circuit if it is not already there.
+    * @brief Parses number matching `0|[1-9]\d{0,8}`.
     *
-    * @param nodes[in,out] - map of nodes in the circuit with number of elements connected to them.
+    * @param[in] token - sequence of characters to parse.
+    * @param[out] value - parsed number.
+    * @return True if @p token is correct number, false otherwise.
     */
-    void add_zero_to_nodes(map<int, int> &nodes) {
-        auto iterator = nodes.find(0);
+    inline bool parse_number(string_view token, int &value) {
+        if (token.empty() || token.size() > MAX_NUMBER_DIGITS || (token[0] == '0' && token.size() > 1))
+            return false;
 
-        if (iterator == nodes.end())
-            nodes.insert(pair<int, int>(0, 0));
+        value = 0;
+        for (char c : token) {
+            if (!is_digit(c))
+                return false;
+            value = value * 10 + (c - '0');
+        }
+        return true;
     }
 
     /**
-    * @brief Lists all elements that are in the circuit.
-    *
-    * Lists all elements that are in the circuit dividing them by tags and types.
-    * Elements are listed in this order: transistors, diodes, resistors, condensators, power sources.
-    * Then within those categories are grouped by element types (each line is one element type)
-    * and sorted by numbers in tags.
-    *
-    * @param data[in,out] - tuple containing data concerning the circuit.
+    * @brief Determines whether given token is correct element type: `([A-Z]|\d)([A-Za-z0-9]|[,\-\/])*`.
     */
-    void list_all_items(mapping_structures &data) {
-        Element elements[5] = {transistor, diode, resistor, condensator, power_source};
+    inline bool is_correct_type(string_view token) {
+        if (token.empty() || !(is_upper(token[0]) || is_digit(token[0])))
+            return false;
 
-        for (Element element : elements)
-            list_element_items(element, data);
+        for (char c : token)
+            if (!is_type_char(c))
+                return false;
+        return true;
     }
 
     /**
-    * @brief Lists nodes in the circuit that are connected to one or less element.
+    * @brief Cuts next maximal sequence of non white characters from the line.
     *
-    * @param data[in,out] - tuple containing data concerning the circuit.
+    * @param[in] line - scanned line.
+    * @param[in, out] pos - position to start from, set past the returned token.
+    * @return Found token, empty if only white characters remained.
     */
-    void list_warnings(mapping_structures &data) {
-        bool no_warnings = true;
+    inline string_view next_token(string_view line, size_t &pos) {
+        while (pos < line.size() && is_space(line[pos]))
+            pos++;
 
-        add_zero_to_nodes(get<2>(data));
+        size_t begin = pos;
+        while (pos < line.size() && !is_space(line[pos]))
+            pos++;
 
-        for (pair<int, int> element : get<2>(data)) {
-            if (element.second < 2) {
-                if (no_warnings) {
-                    cerr << "Warning, unconnected node(s): " << element.first;
-                    no_warnings = false;
-                } else {
-                    cerr << ", " << element.first;
-                }
-            }
+        return line.substr(begin, pos - begin);
+    }
+
+    /**
+    * @brief Scans exactly TERMINALS correct node numbers, one scanner per number of terminals.
+    *
+    * @param[in] line - scanned line.
+    * @param[in, out] pos - position to start from, set past the last node.
+    * @param[out] tokens - tokens receiving the nodes.
+    * @return True if all nodes are correct numbers.
+    */
+    template<int TERMINALS>
+    bool scan_nodes(string_view line, size_t &pos, element_tokens &tokens) {
+        for (int i = 0; i < TERMINALS; i++)
+            if (!parse_number(next_token(line, pos), tokens.nodes[i]))
+                return false;
+        tokens.nodes_count = TERMINALS;
+        return true;
+    }
+
+    using nodes_scanner = bool (*)(string_view, size_t &, element_tokens &);
+
+    template<size_t... TERMINALS>
+    constexpr array<nodes_scanner, sizeof...(TERMINALS)> make_nodes_scanners(index_sequence<TERMINALS...>) {
+        return {&scan_nodes<static_cast<int>(TERMINALS)>...};
+    }
+
+    /**
+    * Scanners of nodes indexed by number of terminals.
+    */
+    constexpr array<nodes_scanner, MAX_TERMINALS + 1> NODES_SCANNERS =
+            make_nodes_scanners(make_index_sequence<MAX_TERMINALS + 1>());
+
+    /**
+    * @brief Validates and tokenizes line in a single pass without allocating memory, one character at a time.
+    * Accepts exactly the same lines as regular expressions from reader::create_regex_for_elements_data()
+    * and returns the same tokens that istringstream would read from them.
+    *
+    * @param[in] line - line to be scanned.
+    * @param[out] tokens - tokens of the element, meaningful only when line_kind::element is returned.
+    * @return line_kind::empty for an empty line, line_kind::element for a correct element description
+    * and line_kind::malformed otherwise.
+    */
+    line_kind scan_line_scalar(string_view line, element_tokens &tokens) {
+        if (line.empty())
+            return line_kind::empty;
+
+        size_t pos = 0;
+        tokens.tag = next_token(line, pos);
+        int terminals = tokens.tag.empty() ? 0 : terminals_of_label(tokens.tag[0]);
+        if (terminals == 0 || !parse_number(tokens.tag.substr(1), tokens.tag_number))
+            return line_kind::malformed;
+
+        tokens.type = next_token(line, pos);
+        if (!is_correct_type(tokens.type) || !NODES_SCANNERS[terminals](line, pos, tokens))
+            return line_kind::malformed;
+
+        return next_token(line, pos).empty() ? line_kind::element : line_kind::malformed;
+    }
+
+    /*
+      Vectorized scanning. A line shorter than SIMD_LINE bytes is copied to a padded buffer and every byte of it
+      is classified at once into bit masks (bit i describes byte i): white characters, digits and characters
+      of the type alphabet. Tokens are then cut with bit operations on the masks and validated by comparing
+      ranges of bits, digit runs are converted to numbers 16 bytes at a time. Longer lines, which hardly
+      ever appear in netlists, and processors without SSE4.2 are served by scan_line_scalar().
+    */
+
+    enum class simd_level {scalar, sse42, avx2};
+
+    constexpr size_t SIMD_LINE = 64; /**< Lines of at most SIMD_LINE - 1 bytes are scanned vectorized. */
+    constexpr size_t SIMD_PADDING = 16; /**< Bytes in front of the line, so that digit runs can be loaded whole. */
+
+    struct byte_classes {
+        uint64_t space;
+        uint64_t digit;
+        uint64_t type;
+    };
+
+    /**
+    * Line copied to the buffer, which is padded with white characters up to SIMD_LINE bytes.
+    */
+    struct padded_line {
+        alignas(64) char bytes[SIMD_PADDING + SIMD_LINE];
+
+        explicit padded_line(string_view line) {
+            memset(bytes, ' ', sizeof(bytes));
+            memcpy(bytes + SIMD_PADDING, line.data(), line.size());
+        }
+
+        const char *data() const {
+            return bytes + SIMD_PADDING;
+        }
+    };
+
+    /**
+    * @brief Returns mask of `count` bits starting at bit `first`, count < 64.
+    */
+    inline uint64_t bit_range(size_t first, size_t count) {
+        return ((uint64_t{1} << count) - 1) << first;
+    }
+
+#if defined(__x86_64__) || defined(__i386__)
+
+    /**
+    * @brief Returns mask of bytes of the chunk that are not greater than `bound` when compared as unsigned.
+    */
+    __attribute__((target("sse4.2")))
+    inline __m128i at_most_sse(__m128i chunk, char bound) {
+        return _mm_cmpeq_epi8(_mm_min_epu8(chunk, _mm_set1_epi8(bound)), chunk);
+    }
+
+    /**
+    * @brief Classifies SIMD_LINE bytes of the padded line, 16 at a time. The type alphabet is matched
+    * by the SSE4.2 string instruction with character ranges.
+    */
+    __attribute__((target("sse4.2")))
+    byte_classes classify_sse42(const char *line) {
+        const __m128i type_ranges = _mm_setr_epi8('0', '9', 'A', 'Z', 'a', 'z', ',', '-', '/', '/',
+                                                  0, 0, 0, 0, 0, 0);
+        byte_classes classes = {0, 0, 0};
+
+        for (size_t i = 0; i < SIMD_LINE; i += 16) {
+            __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(line + i));
+            __m128i space = _mm_or_si128(_mm_cmpeq_epi8(chunk, _mm_set1_epi8(' ')),
+                                         at_most_sse(_mm_sub_epi8(chunk, _mm_set1_epi8('\t')), '\r' - '\t'));
+            __m128i digit = at_most_sse(_mm_sub_epi8(chunk, _mm_set1_epi8('0')), 9);
+            __m128i type = _mm_cmpestrm(type_ranges, 10, chunk, 16,
+                                        _SIDD_UBYTE_OPS | _SIDD_CMP_RANGES | _SIDD_BIT_MASK);
+
+            classes.space |= static_cast<uint64_t>(static_cast<uint16_t>(_mm_movemask_epi8(space))) << i;
+            classes.digit |= static_cast<uint64_t>(static_cast<uint16_t>(_mm_movemask_epi8(digit))) << i;
+            classes.type |= static_cast<uint64_t>(static_cast<uint16_t>(_mm_cvtsi128_si32(type))) << i;
+        }
+        return classes;
+    }
+
+    __attribute__((target("avx2")))
+    inline __m256i at_most_avx2(__m256i chunk, char bound) {
+        return _mm256_cmpeq_epi8(_mm256_min_epu8(chunk, _mm256_set1_epi8(bound)), chunk);
+    }
+
+    /**
+    * @brief Classifies SIMD_LINE bytes of the padded line, 32 at a time.
+    */
+    __attribute__((target("avx2")))
+    byte_classes classify_avx2(const char *line) {
+        byte_classes classes = {0, 0, 0};
+
+        for (size_t i = 0; i < SIMD_LINE; i += 32) {
+            __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(line + i));
+            __m256i space = _mm256_or_si256(_mm256_cmpeq_epi8(chunk, _mm256_set1_epi8(' ')),
+                                            at_most_avx2(_mm256_sub_epi8(chunk, _mm256_set1_epi8('\t')), '\r' - '\t'));
+            __m256i digit = at_most_avx2(_mm256_sub_epi8(chunk, _mm256_set1_epi8('0')), 9);
+            __m256i letter = at_most_avx2(_mm256_sub_epi8(_mm256_or_si256(chunk, _mm256_set1_epi8(0x20)),
+                                                          _mm256_set1_epi8('a')), 'z' - 'a');
+            __m256i punctuation = _mm256_or_si256(
+                    at_most_avx2(_mm256_sub_epi8(chunk, _mm256_set1_epi8(',')), '-' - ','),
+                    _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('/')));
+            __m256i type = _mm256_or_si256(_mm256_or_si256(digit, letter), punctuation);
+
+            classes.space |= static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(space))) << i;
+            classes.digit |= static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(digit))) << i;
+            classes.type |= static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(type))) << i;
+        }
+        return classes;
+    }
+
+    /**
+    * @brief Converts run of 1 to MAX_NUMBER_DIGITS digits ending right before `end` to a number.
+    * The 16 bytes before `end` have to be readable.
+    */
+    __attribute__((target("sse4.2")))
+    int digits_value_sse(const char *end, size_t cnt_digits) {
+        __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(end - 16));
+        const __m128i positions = _mm_setr_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+        __m128i in_run = _mm_cmpgt_epi8(positions, _mm_set1_epi8(static_cast<char>(15 - cnt_digits)));
+        chunk = _mm_and_si128(_mm_sub_epi8(chunk, _mm_set1_epi8('0')), in_run);
+
+        __m128i pairs = _mm_maddubs_epi16(chunk, _mm_setr_epi8(10, 1, 10, 1, 10, 1, 10, 1, 10, 1, 10, 1, 10, 1, 10, 1));
+        __m128i quads = _mm_madd_epi16(pairs, _mm_setr_epi16(100, 1, 100, 1, 100, 1, 100, 1));
+        quads = _mm_packus_epi32(quads, quads);
+        __m128i octets = _mm_madd_epi16(quads, _mm_setr_epi16(10000, 1, 10000, 1, 0, 0, 0, 0));
+
+        return _mm_cvtsi128_si32(octets) * 100000000 + _mm_extract_epi32(octets, 1);
+    }
+
+#endif
+
+    /**
+    * @brief Returns the best level of vectorization supported by the processor.
+    */
+    simd_level detected_simd_level() {
+#if defined(__x86_64__) || defined(__i386__)
+        if (__builtin_cpu_supports("avx2"))
+            return simd_level::avx2;
+        if (__builtin_cpu_supports("sse4.2"))
+            return simd_level::sse42;
+#endif
+        return simd_level::scalar;
+    }
+
+    /**
+    * @brief Level of vectorization used by scan_line(), the detected one unless changed (by tests and benchmarks).
+    */
+    simd_level &active_simd_level() {
+        static simd_level active = detected_simd_level();
+        return active;
+    }
+
+    /**
+    * @brief Cuts next token using the mask of non white characters.
+    *
+    * @param[in] words - mask of non white characters, the highest bit is never set.
+    * @param[in, out] pos - position to start from, set past the returned token.
+    * @param[out] begin - position of the first character of the token.
+    * @return Length of the token, 0 if only white characters remained.
+    */
+    inline size_t next_token_in_mask(uint64_t words, size_t &pos, size_t &begin) {
+        uint64_t ahead = words >> pos << pos;
+        if (ahead == 0)
+            return 0;
+
+        begin = static_cast<size_t>(__builtin_ctzll(ahead));
+        pos = static_cast<size_t>(__builtin_ctzll(~words & (~uint64_t{0} << begin)));
+        return pos - begin;
+    }
+
+    /**
+    * @brief Scans line just like scan_line_scalar() does, using vectorized classification of bytes.
+    *
+    * @param[in] line - line to be scanned, shorter than SIMD_LINE bytes.
+    * @param[out] tokens - tokens of the element, meaningful only when line_kind::element is returned.
+    * @param[in] level - level of vectorization, other than simd_level::scalar.
+    */
+    line_kind scan_line_simd(string_view line, element_tokens &tokens, simd_level level) {
+#if defined(__x86_64__) || defined(__i386__)
+        if (line.empty())
+            return line_kind::empty;
+
+        padded_line padded(line);
+        const char *bytes = padded.data();
+        byte_classes classes = (level == simd_level::avx2 ? classify_avx2(bytes) : classify_sse42(bytes));
+        uint64_t words = ~classes.space & bit_range(0, line.size());
+
+        auto parse_digits = [&](size_t begin, size_t length, int &value) {
+            if (length == 0 || length > MAX_NUMBER_DIGITS || (bytes[begin] == '0' && length > 1)
+                || (classes.digit & bit_range(begin, length)) != bit_range(begin, length))
+                return false;
+            value = digits_value_sse(bytes + begin + length, length);
+            return true;
+        };
+
+        size_t pos = 0, begin = 0;
+        size_t length = next_token_in_mask(words, pos, begin);
+        int terminals = length == 0 ? 0 : terminals_of_label(bytes[begin]);
+        if (terminals == 0 || !parse_digits(begin + 1, length - 1, tokens.tag_number))
+            return line_kind::malformed;
+        tokens.tag = line.substr(begin, length);
+
+        length = next_token_in_mask(words, pos, begin);
+        if (length == 0 || !(is_upper(bytes[begin]) || is_digit(bytes[begin]))
+            || (classes.type & bit_range(begin, length)) != bit_range(begin, length))
+            return line_kind::malformed;
+        tokens.type = line.substr(begin, length);
+
+        for (tokens.nodes_count = 0; tokens.nodes_count < terminals; tokens.nodes_count++) {
+            length = next_token_in_mask(words, pos, begin);
+            if (!parse_digits(begin, length, tokens.nodes[tokens.nodes_count]))
+                return line_kind::malformed;
+        }
+
+        return next_token_in_mask(words, pos, begin) == 0 ? line_kind::element : line_kind::malformed;
+#else
+        (void) level;
+        return scan_line_scalar(line, tokens);
+#endif
+    }
+
+    /**
+    * @brief Validates and tokenizes line, vectorized when the processor allows it. Accepts exactly the same
+    * lines as regular expressions from reader::create_regex_for_elements_data() and returns the same tokens
+    * that istringstream would read from them.
+    *
+    * @param[in] line - line to be scanned.
+    * @param[out] tokens - tokens of the element, meaningful only when line_kind::element is returned.
+    * @return line_kind::empty for an empty line, line_kind::element for a correct element description
+    * and line_kind::malformed otherwise.
+    */
+    inline line_kind scan_line(string_view line, element_tokens &tokens) {
+        simd_level level = active_simd_level();
+        if (level == simd_level::scalar || line.size() >= SIMD_LINE)
+            return scan_line_scalar(line, tokens);
+        return scan_line_simd(line, tokens, level);
+    }
+
+    /**
+    * @brief Collects distinct nodes to which element's terminals are plugged in, in order of appearance.
+    *
+    * @param[in] tokens - tokens of the element.
+    * @param[out] distinct - array receiving distinct nodes.
+    * @return Number of distinct nodes.
+    */
+    inline int distinct_nodes(const element_tokens &tokens, int (&distinct)[MAX_TERMINALS]) {
+        int cnt_distinct = 0;
+        for (int i = 0; i < tokens.nodes_count; i++) {
+            bool seen = false;
+            for (int j = 0; j < cnt_distinct; j++)
+                seen = seen || distinct[j] == tokens.nodes[i];
+            if (!seen)
+                distinct[cnt_distinct++] = tokens.nodes[i];
+        }
+        return cnt_distinct;
+    }
+} // End of namespace scanner.
+
+
+namespace stats {
+
+    enum phase {reading, validation, insertion, items_emission, warnings_emission, CNT_PHASES};
+    enum rejection {bad_syntax, duplicate_tag, single_node, CNT_REJECTIONS};
+
+    const char *const PHASE_NAMES[CNT_PHASES] = {"reading", "validation", "insertion", "items_emission",
+                                                 "warnings_emission"};
+    const char *const REJECTION_NAMES[CNT_REJECTIONS] = {"bad_syntax", "duplicate_tag", "single_node"};
+
+    /**
+    * Time spent in phases of the run and counters of read lines. Collected only when enabled,
+    * and only by the main thread.
+    */
+    struct run_stats {
+        bool enabled = false;
+        double seconds[CNT_PHASES] = {};
+        uint64_t cnt_lines = 0;
+        uint64_t cnt_rejected[CNT_REJECTIONS] = {};
+    };
+
+    run_stats &collected() {
+        static run_stats collected_stats;
+        return collected_stats;
+    }
+
+    inline void count_lines(uint64_t cnt_lines) {
+        if (collected().enabled)
+            collected().cnt_lines += cnt_lines;
+    }
+
+    inline void count_rejection(rejection reason) {
+        if (collected().enabled)
+            collected().cnt_rejected[reason]++;
+    }
+
+    /**
+    * Adds time elapsed between its construction and destruction to the given phase, when stats are enabled.
+    */
+    class phase_timer {
+    private:
+        phase measured;
+        bool enabled;
+        chrono::steady_clock::time_point start;
+
+    public:
+        explicit phase_timer(phase measured) : measured(measured), enabled(collected().enabled) {
+            if (enabled)
+                start = chrono::steady_clock::now();
+        }
+
+        phase_timer(const phase_timer &) = delete;
+        phase_timer &operator=(const phase_timer &) = delete;
+
+        ~phase_timer() {
+            if (enabled)
+                collected().seconds[measured] += chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        }
+    };
+
+    /**
+    * @brief Formats collected stats as lines of text.
+    *
+    * @param[in] cnt_types - number of distinct types in the circuit.
+    * @param[in] cnt_nodes - number of distinct nodes in the circuit.
+    */
+    string format_text(size_t cnt_types, size_t cnt_nodes) {
+        const run_stats &all = collected();
+        ostringstream text;
+
+        text << "Stats: lines read " << all.cnt_lines << ", rejected:";
+        for (int i = 0; i < CNT_REJECTIONS; i++)
+            text << (i == 0 ? " " : ", ") << REJECTION_NAMES[i] << " " << all.cnt_rejected[i];
+        text << endl << "Stats: distinct types " << cnt_types << ", distinct nodes " << cnt_nodes << endl;
+        text << "Stats: seconds:";
+        for (int i = 0; i < CNT_PHASES; i++)
+            text << (i == 0 ? " " : ", ") << PHASE_NAMES[i] << " " << fixed << all.seconds[i];
+        text << endl;
+
+        return text.str();
+    }
+
+    /**
+    * @brief Formats collected stats as a JSON object.
+    *
+    * @param[in] cnt_types - number of distinct types in the circuit.
+    * @param[in] cnt_nodes - number of distinct nodes in the circuit.
+    */
+    string format_json(size_t cnt_types, size_t cnt_nodes) {
+        const run_stats &all = collected();
+        ostringstream json;
+
+        json << "{\"lines_read\": " << all.cnt_lines << ", \"rejected\": {";
+        for (int i = 0; i < CNT_REJECTIONS; i++)
+            json << (i == 0 ? "" : ", ") << "\"" << REJECTION_NAMES[i] << "\": " << all.cnt_rejected[i];
+        json << "}, \"distinct_types\": " << cnt_types << ", \"distinct_nodes\": " << cnt_nodes << ", \"seconds\": {";
+        for (int i = 0; i < CNT_PHASES; i++)
+            json << (i == 0 ? "" : ", ") << "\"" << PHASE_NAMES[i] << "\": " << fixed << all.seconds[i];
+        json << "}}" << endl;
+
+        return json.str();
+    }
+} // End of namespace stats.
+
+
+namespace reader {
+    using namespace circuit_structures;
+    const string EMPTY_STRING = "";
+
+    class wrong_input_exception : public exception {
+    private:
+        string message; /**< Error message to be printed. */
+
+    public:
+        /**
+        * @brief Constructor for wrong_input_exception, concatenates given strings in proper manner
+        * in order to create error message.
+        *
+        * @param[in] incorrect_input - sequence of characters which turned out to be incorrect.
+        * @param[in] line_number - number of the line.
+        */
+        wrong_input_exception(string_view incorrect_input, const int line_number) {
+            this->message = "Error in line " + to_string(line_number) + ": " + string(incorrect_input);
+        }
+
+        const char *what() const noexcept {
+            return this->message.c_str();
+        }
+    };
+
+    /**
+    * @brief Determines whether given string matches given regular expression.
+    *
+    * @param[in] s - sequence to check for match.
+    * @param[in] regex_temple - regular expression which is to be matched.
+    * @return True if s matches @p regex_temple, false otherwise.
+    */
+    bool matches_template(const string &s, const regex &regex_temple) {
+        return regex_match(s, regex_temple);
+    }
+
+    /**
+    * @brief Determines whether given string matches any of regular expressions in the given list.
+    *
+    * @param[in] s - sequence to check for match.
+    * @param[in] regex_list - list of regular expressions which are to be matched.
+    * @return True if @par s matches any regular expression in the given list.
+    */
+    bool matches_any_template(const string &s, list<regex> &regex_list) {
+        for (const auto &reg : regex_list)
+            if (matches_template(s, reg))
+                return true;
+        return false;
+    }
+
+    /**
+    * @brief Creates list of regular expressions that matches correct input.
+    *
+    * @return List of created regular expressions.
+    */
+    list<regex> create_regex_for_elements_data() {
+        list <regex> l;
+
+        // One expression per number of terminals, matching labels of all kinds with that many terminals.
+        for (int terminals = MAX_TERMINALS; terminals > 0; terminals--) {
+            string labels;
+            for (const element_kind &kind : ELEMENT_KINDS)
+                if (kind.terminals == terminals)
+                    labels += kind.label;
+            if (labels.empty())
+                continue;
+
+            l.emplace_back(R"(\s*[)" + labels + R"(](0|[1-9]{1}\d{0,8})\s+([A-Z]|\d)([A-Za-z0-9]|[,\-\/])*)"
+                           + R"((\s+(0|[1-9]{1}\d{0,8})){)" + to_string(terminals) + R"(}\s*)");
+        }
+
+        return l;
+    }
+
+    /**
+    * @brief Increases (+1) counter of terminals plugged in the given node.
+    *
+    * @param[in, out] cnt_nodes_plugs - structure containing counters for every node in the circuit.
+    * @param[in] node_id - id of node whose counter is to be increased.
+    */
+    void update_nodes_plugs(node_table &cnt_nodes_plugs, uint32_t node_id) {
+        cnt_nodes_plugs.increment(node_id);
+    }
+
+    /**
+    * @brief Determines whether element with given tag has been already added to dataset.
+    *
+    * @param[in] data - circuit read so far.
+    * @param[in] element_label - label of element to be checked.
+    * @param[in] element_number - number from the tag of element to be checked.
+    * @return True if similar element has been already added to data, false otherwise.
+    */
+    bool is_repetition(const circuit &data, char element_label, uint32_t element_number) {
+        return data.tags.count(tag_key(element_label, element_number)) > 0;
+    }
+
+    /**
+    * @brief Determines whether read data meets given requirements:
+    * Element's tag is not repetition = elements in circuit must be unique.
+    * Element's terminals have to be plugged into at least two different nodes == distinct_nodes
+    * must be at least two.
+    *
+    * @param data - circuit read so far.
+    * @param tokens - tokens of element to be checked.
+    * @param distinct_nodes - number of distinct nodes to which are connected element's terminals.
+    *
+    * @return True if data meet requirements, false otherwise.
+    */
+    bool is_correct_data(const circuit &data, const scanner::element_tokens &tokens, int distinct_nodes) {
+        return !is_repetition(data, tokens.tag[0], tokens.tag_number) && distinct_nodes > 1;
+    }
+
+    /**
+    * @brief Appends new element to the element table and registers its tag.
+    *
+    * @param[in, out] data - circuit read so far.
+    * @param[in] tokens - tokens of the element.
+    * @param[in] type - id of the element's type, already interned.
+    */
+    void insert_new_element(circuit &data, const scanner::element_tokens &tokens, uint32_t type) {
+        element_table &elements = data.elements;
+        auto index = static_cast<uint32_t>(elements.size());
+        char element_label = tokens.tag[0];
+
+        elements.labels.push_back(element_label);
+        elements.numbers.push_back(tokens.tag_number);
+        elements.types.push_back(type);
+        for (int i = 0; i < MAX_TERMINALS; i++)
+            elements.terminals.push_back(i < tokens.nodes_count ? tokens.nodes[i] : NO_NODE);
+
+        data.tags.emplace(tag_key(element_label, tokens.tag_number), index);
+    }
+
+    void insert_new_element(circuit &data, const scanner::element_tokens &tokens) {
+        insert_new_element(data, tokens, data.types.intern(tokens.type));
+    }
+
+    /**
+    * @brief Removes element from the circuit together with its terminals. The last element
+    * of the element table takes place of the removed one.
+    *
+    * @param[in, out] data - circuit containing the element.
+    * @param[in] index - index of the element in the element table.
+    */
+    void remove_element(circuit &data, uint32_t index) {
+        element_table &elements = data.elements;
+        auto last = static_cast<uint32_t>(elements.size() - 1);
+        const uint32_t *terminals = &elements.terminals[size_t(index) * MAX_TERMINALS];
+
+        for (int i = 0; i < MAX_TERMINALS; i++) {
+            bool seen = terminals[i] == NO_NODE;
+            for (int j = 0; j < i; j++)
+                seen = seen || terminals[j] == terminals[i];
+            if (!seen)
+                data.cnt_nodes_plugs.decrement(terminals[i]);
+        }
+
+        data.tags.erase(tag_key(elements.labels[index], elements.numbers[index]));
+        if (index != last) {
+            elements.labels[index] = elements.labels[last];
+            elements.numbers[index] = elements.numbers[last];
+            elements.types[index] = elements.types[last];
+            copy_n(&elements.terminals[size_t(last) * MAX_TERMINALS], MAX_TERMINALS,
+                   &elements.terminals[size_t(index) * MAX_TERMINALS]);
+            data.tags[tag_key(elements.labels[index], elements.numbers[index])] = index;
+        }
+
+        elements.labels.pop_back();
+        elements.numbers.pop_back();
+        elements.types.pop_back();
+        elements.terminals.resize(size_t(last) * MAX_TERMINALS);
+    }
+
+    /**
+    * @brief Adds element described by already scanned tokens to the circuit.
+    * Assumption: tokens come from a line accepted by scanner::scan_line().
+    * Although element might be repetition, or list of nodes might contain repetitions, therefore
+    * it might still be incorrect.
+    *
+    * @throws wrong_input_exception if line contains input inconsistent with presumptions.
+    * @param[in, out] data - circuit read so far.
+    * @param[in] tokens - tokens of the element description.
+    * @param[in] line - original line, used for error message.
+    * @param[in] cnt_line - parsed lines counter.
+    */
+    void parse_element_description(circuit &data, const scanner::element_tokens &tokens,
+                                   string_view line, int cnt_line) {
+        int nodes_connected[MAX_TERMINALS];
+        int cnt_nodes_connected = scanner::distinct_nodes(tokens, nodes_connected);
+
+        if (!is_correct_data(data, tokens, cnt_nodes_connected)) {
+            stats::count_rejection(is_repetition(data, tokens.tag[0], tokens.tag_number)
+                                   ? stats::duplicate_tag : stats::single_node);
+            throw wrong_input_exception(line, cnt_line);
+        }
+
+        insert_new_element(data, tokens);
+
+        for (int i = 0; i < cnt_nodes_connected; i++)
+            update_nodes_plugs(data.cnt_nodes_plugs, nodes_connected[i]);
+    }
+
+    /**
+    * @brief Reference, regular expressions based validation of a line. Not used by read_data() any more,
+    * kept as the specification scanner::scan_line() is tested against.
+    * String is considered "white" when it's empty or composed only of white characters.
+    *
+    * @throws wrong_input_exception if line contains input inconsistent with presumptions.
+    * @param[in] line - line to be parsed.
+    * @param[in] cnt_line - parsed lines counter.
+    * @return EMPTY_STRING if line was incorrect, empty or "white".
+    * Otherwise string following given template: ELEMENT_TOKEN ELEMENT_TYPE LIST_OF_NODES_CONNECTED_TO_IT'S_TERMINALS
+    */
+    string parse_line(const string &line, int cnt_line,
+                      list<regex> &elements_data_regex, const regex &empty_string_regex) {
+        if (matches_any_template(line, elements_data_regex))
+            return line;
+        else if (matches_template(line, empty_string_regex))
+            return EMPTY_STRING;
+
+        throw wrong_input_exception(line, cnt_line);
+    }
+
+    /**
+    * @brief Adds element from already scanned line to the circuit.
+    *
+    * @throws wrong_input_exception if line is neither empty nor correct description of a new element.
+    * @param[in, out] circuit_data - circuit read so far.
+    * @param[in] kind - result of scanning the line.
+    * @param[in] tokens - tokens of the line, meaningful only for scanner::line_kind::element.
+    * @param[in] line - scanned line.
+    * @param[in] cnt_line - number of the line.
+    */
+    void add_scanned_line(circuit &circuit_data, scanner::line_kind kind,
+                          const scanner::element_tokens &tokens, string_view line, int cnt_line) {
+        switch (kind) {
+            case scanner::line_kind::empty:
+                return;
+            case scanner::line_kind::malformed:
+                stats::count_rejection(stats::bad_syntax);
+                throw wrong_input_exception(line, cnt_line);
+            case scanner::line_kind::element:
+                parse_element_description(circuit_data, tokens, line, cnt_line);
+        }
+    }
+
+    /**
+    * @brief Parses single line of input and adds described element to the circuit.
+    *
+    * @throws wrong_input_exception if line is neither empty nor correct description of a new element.
+    * @param[in, out] circuit_data - circuit read so far.
+    * @param[in] line - line to be parsed.
+    * @param[in] cnt_line - parsed lines counter.
+    */
+    void parse_and_add_line(circuit &circuit_data, string_view line, int cnt_line) {
+        scanner::element_tokens tokens;
+        scanner::line_kind kind = scanner::scan_line(line, tokens);
+        add_scanned_line(circuit_data, kind, tokens, line, cnt_line);
+    }
+
+    /**
+    * Lines of the input read in batches, like getline() reads them, so that reading is timed
+    * once per batch instead of once per line. Strings of a batch are reused by the next one.
+    */
+    class line_batch {
+    private:
+        vector<string> lines;
+        size_t cnt_lines = 0;
+
+    public:
+        static constexpr size_t MAX_LINES = 4096;
+
+        /**
+        * @brief Reads next batch of at most MAX_LINES lines, returns false if there are no more lines.
+        */
+        bool read(istream &input) {
+            stats::phase_timer timer(stats::reading);
+            if (lines.empty())
+                lines.resize(MAX_LINES);
+            cnt_lines = 0;
+            while (cnt_lines < lines.size() && getline(input, lines[cnt_lines]))
+                cnt_lines++;
+            return cnt_lines > 0;
+        }
+
+        size_t size() const {
+            return cnt_lines;
+        }
+
+        const string &operator[](size_t i) const {
+            return lines[i];
+        }
+    };
+
+    /**
+    * @brief Reads circuit description from the standard input, printing errors for incorrect lines.
+    * Lines are read, scanned and added to the circuit in batches, each phase timed once per batch.
+    *
+    * @param[in, out] input - stream with circuit description.
+    * @param[in, out] errors - stream receiving errors.
+    * @return Circuit composed of all correct elements.
+    */
+    circuit read_data(istream &input = cin, ostream &errors = cerr) {
+        circuit circuit_data;
+
+        line_batch batch;
+        vector<scanner::line_kind> kinds(line_batch::MAX_LINES);
+        vector<scanner::element_tokens> tokens(line_batch::MAX_LINES);
+        string batch_errors; /**< Errors of the batch, written once it is added. */
+        int cnt_line = 0;
+        while (batch.read(input)) {
+            {
+                stats::phase_timer timer(stats::validation);
+                for (size_t i = 0; i < batch.size(); i++)
+                    kinds[i] = scanner::scan_line(batch[i], tokens[i]);
+            }
+
+            {
+                stats::phase_timer timer(stats::insertion);
+                for (size_t i = 0; i < batch.size(); i++) {
+                    try {
+                        add_scanned_line(circuit_data, kinds[i], tokens[i], batch[i], ++cnt_line);
+                    } catch (wrong_input_exception &e) {
+                        batch_errors += e.what();
+                        batch_errors += '\n';
+                    }
+                }
+            }
+            errors.write(batch_errors.data(), static_cast<streamsize>(batch_errors.size()));
+            errors.flush();
+            batch_errors.clear();
+        }
+
+        stats::count_lines(static_cast<uint64_t>(cnt_line));
+        return circuit_data;
+    }
+} // End of namespace reader.
+
+namespace parallel_reader {
+    using namespace circuit_structures;
+
+    /**
+    * Read-only memory mapping of a whole file, unmapped on destruction.
+    */
+    class mapped_file {
+    private:
+        void *address = nullptr; /**< Beginning of the mapping, nullptr for empty files. */
+        size_t length = 0; /**< Size of the mapped file. */
+
+    public:
+        /**
+        * @brief Maps file with given path to memory.
+        *
+        * @throws runtime_error if file cannot be opened, its size cannot be read or it cannot be mapped.
+        * @param[in] path - path to the file.
+        */
+        explicit mapped_file(const string &path) {
+            int fd = open(path.c_str(), O_RDONLY);
+            if (fd < 0)
+                throw runtime_error("Cannot open file " + path + ": " + strerror(errno));
+
+            struct stat file_stat;
+            if (fstat(fd, &file_stat) != 0) {
+                int error = errno;
+                close(fd);
+                throw runtime_error("Cannot read file " + path + ": " + strerror(error));
+            }
+            if (file_stat.st_size > 0) {
+                length = static_cast<size_t>(file_stat.st_size);
+                address = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+            }
+            close(fd);
+
+            if (address == MAP_FAILED)
+                throw runtime_error("Cannot map file " + path + ": " + strerror(errno));
+            if (address != nullptr)
+                madvise(address, length, MADV_SEQUENTIAL);
+        }
+
+        mapped_file(const mapped_file &) = delete;
+        mapped_file &operator=(const mapped_file &) = delete;
+
+        ~mapped_file() {
+            if (address != nullptr)
+                munmap(address, length);
+        }
+
+        string_view contents() const {
+            return string_view(static_cast<const char *>(address), length);
+        }
+    };
+
+    /**
+    * What the worker found out about an element line from its chunk alone.
+    */
+    enum class chunk_verdict {
+        first_of_tag, /**< Correct, first correct line of its tag in the chunk; earlier chunks may repeat the tag. */
+        repeated_tag, /**< Repeats the tag of a correct line earlier in the chunk. */
+        single_node /**< Plugged into a single node; its tag may still repeat one from earlier chunks. */
+    };
+
+    /**
+    * Non-empty line scanned by a worker, waiting to be added to the circuit.
+    */
+    struct scanned_line {
+        string_view line;
+        int local_line; /**< Number of the line within its chunk, counted from 1. */
+        scanner::line_kind kind;
+        scanner::element_tokens tokens;
+        chunk_verdict verdict; /**< Meaningful only for scanner::line_kind::element, like the fields below. */
+        uint32_t local_type; /**< Index of the element's type in chunk_result::types. */
+        int cnt_nodes_connected;
+        int nodes_connected[MAX_TERMINALS];
+    };
+
+    /**
+    * All non-empty lines of a chunk, in order, together with the number of lines in the chunk
+    * and distinct types of its elements, in order of first appearance.
+    */
+    struct chunk_result {
+        vector<scanned_line> lines;
+        vector<string_view> types;
+        int cnt_lines = 0;
+    };
+
+    constexpr size_t CHUNK_BYTES = 1 << 20; /**< Files are split into chunks of about this size, or smaller. */
+    constexpr size_t CHUNKS_AHEAD_PER_THREAD = 2; /**< Chunks scanned ahead of insertion, per thread. */
+
+    /**
+    * Chunks handed out to scanning threads in order, at most window of them ahead of the first chunk
+    * not yet added to the circuit, so that scanned lines waiting for insertion take bounded memory.
+    */
+    class chunk_queue {
+    private:
+        mutex lock;
+        condition_variable changed;
+        size_t cnt_chunks;
+        size_t window;
+        size_t next = 0; /**< First chunk not handed out yet. */
+        size_t cnt_inserted = 0;
+        vector<char> scanned;
+
+    public:
+        chunk_queue(size_t cnt_chunks, size_t window) : cnt_chunks(cnt_chunks), window(window), scanned(cnt_chunks) {}
+
+        /**
+        * @brief Hands out the next chunk, waiting while the window is full.
+        *
+        * @return Index of the chunk, number of chunks if all have been handed out.
+        */
+        size_t take() {
+            unique_lock<mutex> guard(lock);
+            changed.wait(guard, [this]() { return next == cnt_chunks || next < cnt_inserted + window; });
+            return next == cnt_chunks ? cnt_chunks : next++;
+        }
+
+        /**
+        * @brief Hands out given chunk if it is the next one, so the inserting thread scans it itself.
+        */
+        bool take_if_next(size_t chunk) {
+            lock_guard<mutex> guard(lock);
+            if (next != chunk)
+                return false;
+            next++;
+            return true;
+        }
+
+        void mark_scanned(size_t chunk) {
+            {
+                lock_guard<mutex> guard(lock);
+                scanned[chunk] = true;
+            }
+            changed.notify_all();
+        }
+
+        void wait_until_scanned(size_t chunk) {
+            unique_lock<mutex> guard(lock);
+            changed.wait(guard, [this, chunk]() { return scanned[chunk] != 0; });
+        }
+
+        void mark_inserted() {
+            {
+                lock_guard<mutex> guard(lock);
+                cnt_inserted++;
+            }
+            changed.notify_all();
+        }
+    };
+
+    /**
+    * @brief Splits text into at most cnt_chunks pieces of similar size, cutting only right after '\n'.
+    *
+    * @param[in] text - text to be split.
+    * @param[in] cnt_chunks - desired number of chunks.
+    * @return Consecutive, non-empty chunks covering whole text.
+    */
+    vector<string_view> split_into_chunks(string_view text, size_t cnt_chunks) {
+        vector<string_view> chunks;
+        size_t chunk_size = text.size() / cnt_chunks + 1;
+        size_t begin = 0;
+
+        while (begin < text.size()) {
+            size_t end = text.find('\n', min(begin + chunk_size, text.size()) - 1);
+            end = (end == string_view::npos ? text.size() : end + 1);
+            chunks.push_back(text.substr(begin, end - begin));
+            begin = end;
+        }
+
+        return chunks;
+    }
+
+    /**
+    * Set of tags of a chunk's lines: open addressing over an array with at least twice as many slots
+    * as the chunk has lines, so it never grows.
+    */
+    class chunk_tag_set {
+    private:
+        static constexpr uint64_t EMPTY_KEY = UINT64_MAX; /**< No tag_key() is all ones. */
+        vector<uint64_t> keys;
+        int shift;
+
+    public:
+        explicit chunk_tag_set(size_t cnt_lines) {
+            int capacity_bits = 4;
+            while ((size_t(1) << capacity_bits) < 2 * cnt_lines)
+                capacity_bits++;
+            keys.assign(size_t(1) << capacity_bits, EMPTY_KEY);
+            shift = 64 - capacity_bits;
+        }
+
+        /**
+        * @brief Adds the key to the set.
+        *
+        * @return True if the key was not in the set before.
+        */
+        bool insert(uint64_t key) {
+            size_t mask = keys.size() - 1;
+            size_t slot = static_cast<size_t>((key * 0x9E3779B97F4A7C15ull) >> shift);
+            while (keys[slot] != EMPTY_KEY && keys[slot] != key)
+                slot = (slot + 1) & mask;
+            if (keys[slot] == key)
+                return false;
+            keys[slot] = key;
+            return true;
+        }
+
+        bool contains(uint64_t key) const {
+            size_t mask = keys.size() - 1;
+            size_t slot = static_cast<size_t>((key * 0x9E3779B97F4A7C15ull) >> shift);
+            while (keys[slot] != EMPTY_KEY && keys[slot] != key)
+                slot = (slot + 1) & mask;
+            return keys[slot] == key;
+        }
+    };
+
+    /**
+    * @brief Checks element lines of a scanned chunk against earlier lines of the chunk. A set of the chunk
+    * records tags of its correct lines, so that only the first correct line of every tag has to be checked
+    * against the circuit, and a map gives chunk's own ids to types, so that every distinct type of the chunk
+    * is interned once.
+    *
+    * @param[in, out] result - scanned chunk, receiving verdicts, nodes and types of its element lines.
+    */
+    void check_chunk(chunk_result &result) {
+        chunk_tag_set correct_tags(result.lines.size());
+        unordered_map<string_view, uint32_t> local_types; /**< {type} -> {index in result.types} */
+
+        for (scanned_line &scanned : result.lines) {
+            if (scanned.kind != scanner::line_kind::element)
+                continue;
+
+            const scanner::element_tokens &tokens = scanned.tokens;
+            uint64_t key = tag_key(tokens.tag[0], static_cast<uint32_t>(tokens.tag_number));
+            scanned.cnt_nodes_connected = scanner::distinct_nodes(tokens, scanned.nodes_connected);
+            if (correct_tags.contains(key))
+                scanned.verdict = chunk_verdict::repeated_tag;
+            else if (scanned.cnt_nodes_connected < 2)
+                scanned.verdict = chunk_verdict::single_node;
+            else {
+                scanned.verdict = chunk_verdict::first_of_tag;
+                correct_tags.insert(key);
+            }
+
+            auto type = local_types.try_emplace(tokens.type, static_cast<uint32_t>(result.types.size()));
+            if (type.second)
+                result.types.push_back(tokens.type);
+            scanned.local_type = type.first->second;
+        }
+    }
+
+    /**
+    * @brief Scans every line of the chunk, then checks its element lines with check_chunk().
+    * Lines are split the same way getline() splits them.
+    *
+    * @param[in] chunk - chunk of the input, ending right after '\n' or at the end of the input.
+    * @param[out] result - scanned non-empty lines, distinct types and number of all lines of the chunk.
+    */
+    void scan_chunk(string_view chunk, chunk_result &result) {
+        size_t begin = 0;
+
+        while (begin < chunk.size()) {
+            size_t end = chunk.find('\n', begin);
+            if (end == string_view::npos)
+                end = chunk.size();
+
+            result.cnt_lines++;
+            scanned_line scanned;
+            scanned.line = chunk.substr(begin, end - begin);
+            scanned.kind = scanner::scan_line(scanned.line, scanned.tokens);
+            if (scanned.kind != scanner::line_kind::empty) {
+                scanned.local_line = result.cnt_lines;
+                result.lines.push_back(scanned);
+            }
+
+            begin = end + 1;
+        }
+
+        check_chunk(result);
+    }
+
+    /**
+    * @brief Adds element line checked by scan_chunk() to the circuit, like reader::add_scanned_line() adds
+    * any scanned line: the tag of the first correct line of its tag in the chunk is looked up in the circuit,
+    * and so are tags of lines with a single node, only to tell why they are rejected.
+    *
+    * @throws reader::wrong_input_exception if the element is not correct.
+    * @param[in, out] data - circuit read so far, containing all elements of earlier chunks.
+    * @param[in] scanned - scanned element line.
+    * @param[in, out] types - ids of chunk's types in the circuit, NO_TYPE for types not interned yet.
+    * @param[in] cnt_line - number of the line.
+    */
+    void add_checked_element(circuit &data, const scanned_line &scanned, vector<uint32_t> &types, int cnt_line) {
+        const scanner::element_tokens &tokens = scanned.tokens;
+
+        bool is_repetition = scanned.verdict == chunk_verdict::repeated_tag
+                             || reader::is_repetition(data, tokens.tag[0], static_cast<uint32_t>(tokens.tag_number));
+        if (is_repetition || scanned.verdict == chunk_verdict::single_node) {
+            stats::count_rejection(is_repetition ? stats::duplicate_tag : stats::single_node);
+            throw reader::wrong_input_exception(scanned.line, cnt_line);
+        }
+
+        uint32_t &type = types[scanned.local_type];
+        if (type == type_interner::NO_TYPE)
+            type = data.types.intern(tokens.type);
+        reader::insert_new_element(data, tokens, type);
+
+        for (int i = 0; i < scanned.cnt_nodes_connected; i++)
+            reader::update_nodes_plugs(data.cnt_nodes_plugs, static_cast<uint32_t>(scanned.nodes_connected[i]));
+    }
+
+    /**
+    * @brief Reads circuit from a file like reader::read_data() reads it from the standard input,
+    * producing the same data and the same errors in the same order.
+    * The file is mapped to memory and split into chunks of at most about CHUNK_BYTES, which are scanned
+    * in parallel, together with everything that can be checked within a chunk alone (see scan_chunk()).
+    * Scanned chunks are added to the circuit one by one in order of lines, as soon as they are ready,
+    * so the first occurrence of a tag wins and errors are printed in ascending order of line numbers.
+    * Lines of a chunk are freed once it is added and scanning stays a bounded number of chunks ahead,
+    * so scanned lines never take memory proportional to the file.
+    *
+    * @throws runtime_error if file cannot be read.
+    * @param[in] path - path to the file containing circuit description.
+    * @param[in] cnt_threads - number of threads scanning the file.
+    * @param[in, out] errors - stream receiving errors.
+    * @return Circuit composed of all correct elements.
+    */
+    circuit read_file(const string &path, unsigned cnt_threads, ostream &errors = cerr) {
+        unique_ptr<mapped_file> file;
+        {
+            stats::phase_timer timer(stats::reading);
+            file = make_unique<mapped_file>(path);
+        }
+        cnt_threads = max(cnt_threads, 1u);
+        string_view text = file->contents();
+        vector<string_view> chunks = split_into_chunks(text, max<size_t>(cnt_threads, text.size() / CHUNK_BYTES + 1));
+        vector<chunk_result> results(chunks.size());
+        chunk_queue queue(chunks.size(), CHUNKS_AHEAD_PER_THREAD * cnt_threads);
+
+        vector<thread> workers;
+        for (unsigned i = 1; i < cnt_threads && i < chunks.size(); i++)
+            workers.emplace_back([&chunks, &results, &queue]() {
+                for (size_t chunk = queue.take(); chunk < chunks.size(); chunk = queue.take()) {
+                    scan_chunk(chunks[chunk], results[chunk]);
+                    queue.mark_scanned(chunk);
+                }
+            });
+
+        circuit circuit_data;
+        int first_line = 0;
+        for (size_t i = 0; i < chunks.size(); i++) {
+            {
+                stats::phase_timer timer(stats::validation);
+                if (queue.take_if_next(i))
+                    scan_chunk(chunks[i], results[i]);
+                else
+                    queue.wait_until_scanned(i);
+            }
+
+            stats::phase_timer timer(stats::insertion);
+            vector<uint32_t> types(results[i].types.size(), type_interner::NO_TYPE);
+            for (const scanned_line &scanned : results[i].lines) {
+                try {
+                    if (scanned.kind == scanner::line_kind::element)
+                        add_checked_element(circuit_data, scanned, types, first_line + scanned.local_line);
+                    else
+                        reader::add_scanned_line(circuit_data, scanned.kind, scanned.tokens, scanned.line,
+                                                 first_line + scanned.local_line);
+                } catch (reader::wrong_input_exception &e) {
+                    errors << e.what() << endl;
+                }
+            }
+            first_line += results[i].cnt_lines;
+            results[i] = chunk_result();
+            queue.mark_inserted();
+        }
+        for (thread &worker : workers)
+            worker.join();
+
+        stats::count_lines(static_cast<uint64_t>(first_line));
+        return circuit_data;
+    }
+} // End of namespace parallel_reader.
+
+namespace writer {
+    using namespace circuit_structures;
+
+    constexpr int NUMBER_BITS = 30; /**< Numbers in tags are below 10^9 < 2^30. */
+
+    /**
+    * @brief Appends decimal representation of given number to the buffer.
+    */
+    void append_number(string &buffer, uint32_t number) {
+        char digits[16];
+        auto result = to_chars(digits, digits + sizeof(digits), number);
+        buffer.append(digits, result.ptr);
+    }
+
+    /**
+    * Buffers used by format_all_items(), which may be kept between calls, so that formatting lists of many
+    * circuits one by one does not allocate them again for each circuit.
+    */
+    struct items_scratch {
+        vector<size_t> partitions;
+        vector<size_t> positions;
+        vector<uint64_t> records;
+        vector<size_t> bounds;
+        vector<pair<uint64_t, uint32_t>> lines;
+        vector<size_t> piece_bounds;
+        vector<string> pieces;
+    };
+
+    /**
+    * @brief Formats list of all elements of the circuit, see list_all_items().
+    * Elements are partitioned by labels with a counting sort, each partition is sorted by (type, number),
+    * which makes lines of the list contiguous, and then lines are sorted by (label's rank, smallest number
+    * in the line). Sorting and formatting are split among threads, the first range of lines is formatted
+    * straight into the buffer, every other thread formats a contiguous range of lines into its own piece
+    * and the pieces are appended in order.
+    *
+    * @param data[in] - view of the circuit to be listed.
+    * @param buffer[out] - buffer the lines are written to, cleared first.
+    * @param scratch[in, out] - buffers reused between calls.
+    * @param cnt_threads[in] - number of threads to use.
+    */
+    void format_all_items(const circuit_view &data, string &buffer, items_scratch &scratch, unsigned cnt_threads = 1) {
+        /** Records of label's rank r are in [partitions[r], [r + 1]). */
+        vector<size_t> &partitions = scratch.partitions;
+        partitions.assign(CNT_KINDS + 1, 0);
+        for (size_t i = 0; i < data.cnt_elements; i++)
+            partitions[label_rank(data.labels[i]) + 1]++;
+        for (size_t rank = 1; rank <= CNT_KINDS; rank++)
+            partitions[rank] += partitions[rank - 1];
+
+        vector<uint64_t> &records = scratch.records; /**< (type, number) */
+        vector<size_t> &positions = scratch.positions;
+        records.resize(data.cnt_elements);
+        positions.assign(partitions.begin(), partitions.end() - 1);
+        for (size_t i = 0; i < data.cnt_elements; i++)
+            records[positions[label_rank(data.labels[i])]++] = (uint64_t{data.types[i]} << 32) | data.numbers[i];
+        for (size_t rank = 0; rank < CNT_KINDS; rank++)
+            parallel_sort(records.data() + partitions[rank], records.data() + partitions[rank + 1], cnt_threads);
+
+        vector<size_t> &bounds = scratch.bounds; /**< Line g of the list holds records [bounds[g], bounds[g + 1]). */
+        vector<pair<uint64_t, uint32_t>> &lines = scratch.lines; /**< (label's rank, smallest number), index of line in bounds */
+        bounds.clear();
+        lines.clear();
+        for (size_t rank = 0; rank < CNT_KINDS; rank++) {
+            for (size_t i = partitions[rank]; i < partitions[rank + 1]; i++) {
+                if (i > partitions[rank] && records[i] >> 32 == records[i - 1] >> 32)
+                    continue;
+                lines.emplace_back((rank << NUMBER_BITS) | static_cast<uint32_t>(records[i]),
+                                   static_cast<uint32_t>(bounds.size()));
+                bounds.push_back(i);
+            }
+        }
+        bounds.push_back(records.size());
+        parallel_sort(lines.data(), lines.data() + lines.size(), cnt_threads);
+
+        auto format_lines = [&](size_t first_line, size_t last_line, string &piece) {
+            for (size_t line = first_line; line < last_line; line++) {
+                char label = ELEMENT_KINDS[lines[line].first >> NUMBER_BITS].label;
+                size_t begin = bounds[lines[line].second], end = bounds[lines[line].second + 1];
+
+                for (size_t i = begin; i < end; i++) {
+                    if (i > begin)
+                        piece += ", ";
+                    piece += label;
+                    append_number(piece, static_cast<uint32_t>(records[i]));
+                }
+                piece += ": ";
+                piece += data.type_of(static_cast<uint32_t>(records[begin] >> 32));
+                piece += '\n';
+            }
+        };
+
+        // Ranges of lines with similar numbers of elements, one per thread.
+        size_t cnt_pieces = min<size_t>(max(cnt_threads, 1u), records.size() / PARALLEL_GRAIN + 1);
+        vector<size_t> &piece_bounds = scratch.piece_bounds;
+        piece_bounds.assign(1, 0);
+        for (size_t line = 0, cnt_records = 0; line < lines.size(); line++) {
+            cnt_records += bounds[lines[line].second + 1] - bounds[lines[line].second];
+            if (cnt_records * cnt_pieces >= records.size() * piece_bounds.size() && line + 1 < lines.size())
+                piece_bounds.push_back(line + 1);
+        }
+        piece_bounds.push_back(lines.size());
+
+        vector<string> &pieces = scratch.pieces;
+        if (pieces.size() < piece_bounds.size() - 1)
+            pieces.resize(piece_bounds.size() - 1);
+        vector<thread> workers;
+        for (size_t piece = 1; piece + 1 < piece_bounds.size(); piece++) {
+            pieces[piece].clear();
+            workers.emplace_back(format_lines, piece_bounds[piece], piece_bounds[piece + 1], ref(pieces[piece]));
+        }
+        buffer.clear();
+        format_lines(piece_bounds[0], piece_bounds[1], buffer);
+        for (thread &worker : workers)
+            worker.join();
+
+        size_t total_size = buffer.size();
+        for (size_t piece = 1; piece + 1 < piece_bounds.size(); piece++)
+            total_size += pieces[piece].size();
+        buffer.reserve(total_size);
+        for (size_t piece = 1; piece + 1 < piece_bounds.size(); piece++)
+            buffer += pieces[piece];
+    }
+
+    /**
+    * @brief Formats list of all elements of the circuit, see list_all_items().
+    *
+    * @param data[in] - view of the circuit to be listed.
+    * @param cnt_threads[in] - number of threads to use.
+    * @return Formatted lines.
+    */
+    string format_all_items(const circuit_view &data, unsigned cnt_threads = 1) {
+        string buffer;
+        items_scratch scratch;
+        format_all_items(data, buffer, scratch, cnt_threads);
+        return buffer;
+    }
+
+    /**
+    * @brief Returns sorted nodes connected to one or less element. Node number 0 is always present
+    * in the circuit, so it is listed also when no element is connected to it.
+    *
+    * @param nodes[in] - numbers of terminals plugged into nodes of the circuit.
+    */
+    vector<uint32_t> unconnected_nodes(const node_table &nodes) {
+        vector<uint32_t> unconnected = nodes.sorted_nodes_below(2);
+
+        if (nodes.count(0) == 0)
+            unconnected.insert(unconnected.begin(), 0);
+        return unconnected;
+    }
+
+    /**
+    * @brief Lists all elements that are in the circuit.
+    *
+    * Lists all elements that are in the circuit dividing them by tags and types.
+    * Elements are listed in the order of ELEMENT_KINDS: transistors, diodes, resistors, condensators, power sources.
+    * Then within those categories are grouped by element types (each line is one element type)
+    * and sorted by numbers in tags.
+    * Whole list is formatted into one buffer and written at once.
+    *
+    * @param data[in] - view of the circuit to be listed.
+    * @param cnt_threads[in] - number of threads formatting the list.
+    */
+    void list_all_items(const circuit_view &data, unsigned cnt_threads = 1) {
+        stats::phase_timer timer(stats::items_emission);
+        string buffer = format_all_items(data, cnt_threads);
+
+        cout.write(buffer.data(), static_cast<streamsize>(buffer.size()));
+        cout.flush();
+    }
+
+    /**
+    * @brief Formats warning about nodes in the circuit that are connected to one or less element.
+    *
+    * @param unconnected[in] - sorted numbers of such nodes.
+    * @return Formatted warning line, empty if there are no such nodes.
+    */
+    string format_warnings(const vector<uint32_t> &unconnected) {
+        string buffer;
+
+        for (uint32_t node : unconnected) {
+            buffer += (buffer.empty() ? "Warning, unconnected node(s): " : ", ");
+            append_number(buffer, node);
+        }
+
+        if (!buffer.empty())
+            buffer += '\n';
+        return buffer;
+    }
+
+    /**
+    * @brief Lists given nodes that are connected to one or less element.
+    *
+    * @param unconnected[in] - sorted numbers of such nodes.
+    */
+    void list_warnings(const vector<uint32_t> &unconnected) {
+        stats::phase_timer timer(stats::warnings_emission);
+        string buffer = format_warnings(unconnected);
+
+        cerr.write(buffer.data(), static_cast<streamsize>(buffer.size()));
+    }
+
+    /**
+    * @brief Lists all elements that are in the circuit, see list_all_items(const circuit_view &).
+    */
+    void list_all_items(const circuit &data, unsigned cnt_threads = 1) {
+        list_all_items(data.view(), cnt_threads);
+    }
+
+    /**
+    * @brief Lists nodes in the circuit that are connected to one or less element.
+    *
+    * @param data[in] - circuit to be checked.
+    */
+    void list_warnings(const circuit &data) {
+        vector<uint32_t> unconnected;
+        {
+            stats::phase_timer timer(stats::warnings_emission);
+            unconnected = unconnected_nodes(data.cnt_nodes_plugs);
+        }
+        list_warnings(unconnected);
+    }
+} // End of the namespace writer.
+
+namespace incremental {
+    using namespace circuit_structures;
+
+    /**
+    * Effects of a single command: the change of the list of elements, and warnings about nodes which
+    * became or stopped being unconnected. A line of the list which appears is printed prefixed with '+',
+    * a line which disappears with '-'; a line which only gains or loses a tag is printed as '~', its
+    * label and type, and the tag prefixed with '+' or '-'.
+    */
+    struct delta {
+        string items;
+        string warnings;
+    };
+
+    /**
+    * Circuit kept in memory between edits. Only the number of elements in every line of the list
+    * of elements is kept, in flat arrays indexed by label and type, so an edit takes constant time
+    * apart from the nodes of the edited element.
+    */
+    class session {
+    private:
+        circuit &data;
+        array<vector<uint32_t>, CNT_KINDS> line_sizes; /**< [label's rank][type] -> number of elements */
+
+        /**
+        * @brief Determines whether node is listed in the warning about unconnected nodes.
+        */
+        bool is_unconnected(uint32_t node) const {
+            uint32_t plugs = data.cnt_nodes_plugs.count(node);
+            return node == 0 ? plugs < 2 : plugs == 1;
+        }
+
+        uint32_t &line_size(char label, uint32_t type) {
+            vector<uint32_t> &sizes = line_sizes[label_rank(label)];
+            if (type >= sizes.size())
+                sizes.resize(max<size_t>(2 * sizes.size(), type + 1), 0);
+            return sizes[type];
+        }
+
+        /**
+        * @brief Appends warning listing given nodes to the buffer, does nothing when there are no nodes.
+        */
+        static void append_nodes(string &buffer, const char *header, vector<uint32_t> &nodes) {
+            sort(nodes.begin(), nodes.end());
+            for (size_t i = 0; i < nodes.size(); i++) {
+                buffer += (i == 0 ? header : ", ");
+                writer::append_number(buffer, nodes[i]);
+            }
+            if (!nodes.empty())
+                buffer += '\n';
+        }
+
+        /**
+        * @brief Adds (or removes) element with given tag to the line of its label and type and describes
+        * the change of the line.
+        */
+        void update_line(delta &result, char label, uint32_t type, uint32_t number, bool adding) {
+            uint32_t &size = line_size(label, type);
+            size = adding ? size + 1 : size - 1;
+
+            string &buffer = result.items;
+            string_view type_name = data.types.type_of(type);
+            char sign = adding ? '+' : '-';
+            if (size == (adding ? 1u : 0u)) {
+                buffer += sign;
+                buffer += label;
+                writer::append_number(buffer, number);
+                buffer += ": ";
+                buffer += type_name;
+            }
+            else {
+                buffer += '~';
+                buffer += label;
+                buffer += ": ";
+                buffer += type_name;
+                buffer += ' ';
+                buffer += sign;
+                buffer += label;
+                writer::append_number(buffer, number);
+            }
+            buffer += '\n';
+        }
+
+        /**
+        * @brief Describes nodes whose status changed since it was recorded in were_unconnected.
+        */
+        void update_nodes(delta &result, const vector<uint32_t> &nodes, const vector<bool> &were_unconnected) const {
+            vector<uint32_t> added, resolved;
+
+            for (size_t i = 0; i < nodes.size(); i++) {
+                bool unconnected = is_unconnected(nodes[i]);
+                if (unconnected && !were_unconnected[i])
+                    added.push_back(nodes[i]);
+                else if (!unconnected && were_unconnected[i])
+                    resolved.push_back(nodes[i]);
+            }
+
+            append_nodes(result.warnings, "Warning, unconnected node(s) added: ", added);
+            append_nodes(result.warnings, "Warning, unconnected node(s) resolved: ", resolved);
+        }
+
+        vector<bool> statuses(const vector<uint32_t> &nodes) const {
+            vector<bool> unconnected;
+            for (uint32_t node : nodes)
+                unconnected.push_back(is_unconnected(node));
+            return unconnected;
+        }
+
+        /**
+        * @brief Adds element described in the command, like reader::read_data() would.
+        *
+        * @throws wrong_input_exception if description is incorrect or the tag is already used.
+        */
+        delta add(string_view command, string_view description, int cnt_line) {
+            delta result;
+            scanner::element_tokens tokens;
+            if (scanner::scan_line(description, tokens) != scanner::line_kind::element)
+                throw reader::wrong_input_exception(command, cnt_line);
+
+            int distinct[MAX_TERMINALS];
+            vector<uint32_t> nodes(distinct, distinct + scanner::distinct_nodes(tokens, distinct));
+            vector<bool> were_unconnected = statuses(nodes);
+
+            reader::parse_element_description(data, tokens, command, cnt_line);
+
+            auto index = static_cast<uint32_t>(data.elements.size() - 1);
+            update_line(result, tokens.tag[0], data.elements.types[index], tokens.tag_number, true);
+            update_nodes(result, nodes, were_unconnected);
+            return result;
+        }
+
+        /**
+        * @brief Removes element with tag given in the command.
+        *
+        * @throws wrong_input_exception if tag is incorrect or there is no such element.
+        */
+        delta remove(string_view command, string_view tag_description, int cnt_line) {
+            delta result;
+            size_t pos = 0;
+            string_view tag = scanner::next_token(tag_description, pos);
+            int number;
+            if (tag.empty() || scanner::terminals_of_label(tag[0]) == 0 || !scanner::parse_number(tag.substr(1), number)
+                || !scanner::next_token(tag_description, pos).empty())
+                throw reader::wrong_input_exception(command, cnt_line);
+
+            auto iterator = data.tags.find(tag_key(tag[0], number));
+            if (iterator == data.tags.end())
+                throw reader::wrong_input_exception(command, cnt_line);
+
+            uint32_t index = iterator->second;
+            const uint32_t *terminals = &data.elements.terminals[size_t(index) * MAX_TERMINALS];
+            vector<uint32_t> nodes;
+            for (int i = 0; i < MAX_TERMINALS; i++)
+                if (terminals[i] != NO_NODE && find(nodes.begin(), nodes.end(), terminals[i]) == nodes.end())
+                    nodes.push_back(terminals[i]);
+            vector<bool> were_unconnected = statuses(nodes);
+            uint32_t type = data.elements.types[index];
+
+            reader::remove_element(data, index);
+
+            update_line(result, tag[0], type, static_cast<uint32_t>(number), false);
+            update_nodes(result, nodes, were_unconnected);
+            return result;
+        }
+
+    public:
+        explicit session(circuit &data) : data(data) {
+            for (uint32_t i = 0; i < data.elements.size(); i++)
+                line_size(data.elements.labels[i], data.elements.types[i])++;
+        }
+
+        /**
+        * @brief Executes single command: "+DESCRIPTION" adds element, "-TAG" removes element,
+        * empty lines are ignored.
+        *
+        * @throws wrong_input_exception if command is incorrect.
+        * @param[in] command - line containing the command.
+        * @param[in] cnt_line - number of the line.
+        * @return Effects of the command.
+        */
+        delta execute(string_view command, int cnt_line) {
+            if (command.empty())
+                return delta();
+            if (command[0] == '+')
+                return add(command, command.substr(1), cnt_line);
+            if (command[0] == '-')
+                return remove(command, command.substr(1), cnt_line);
+
+            throw reader::wrong_input_exception(command, cnt_line);
+        }
+    };
+
+    /**
+    * @brief Lists the whole circuit, then executes commands from the standard input, listing only
+    * effects of every command.
+    *
+    * @param[in, out] data - initial circuit.
+    */
+    void run(circuit &data) {
+        writer::list_all_items(data);
+        writer::list_warnings(data);
+
+        session edits(data);
+        string line;
+        int cnt_line = 0;
+        while (getline(cin, line)) {
+            cnt_line++;
+
+            try {
+                delta result = edits.execute(line, cnt_line);
+                cout.write(result.items.data(), static_cast<streamsize>(result.items.size()));
+                cout.flush();
+                cerr.write(result.warnings.data(), static_cast<streamsize>(result.warnings.size()));
+            } catch (reader::wrong_input_exception &e) {
+                cerr << e.what() << endl;
+            }
+        }
+    }
+} // End of namespace incremental.
+
+namespace snapshot {
+    using namespace circuit_structures;
+
+    const char MAGIC[8] = {'O', 'B', 'W', 'S', 'N', 'A', 'P', '\0'};
+    constexpr uint32_t VERSION = 1;
+    constexpr uint32_t BYTE_ORDER_MARK = 0x01020304;
+
+    /**
+    * Beginning of a snapshot file. It is followed by arrays of uint32_t: numbers, types,
+    * terminals (MAX_TERMINALS per element), type_offsets (cnt_types + 1), node_ids (sorted)
+    * and node_counts, and then by arrays of chars: labels and type_chars.
+    */
+    struct header {
+        char magic[8];
+        uint32_t version;
+        uint32_t byte_order; /**< BYTE_ORDER_MARK as written by the machine which created the snapshot. */
+        uint64_t cnt_elements;
+        uint64_t cnt_types;
+        uint64_t cnt_type_chars;
+        uint64_t cnt_nodes;
+    };
+
+    /**
+    * @brief Returns size of the snapshot file described by the header.
+    */
+    uint64_t file_size(const header &described) {
+        uint64_t cnt_numbers = described.cnt_elements * (2 + MAX_TERMINALS) + described.cnt_types + 1
+                               + 2 * described.cnt_nodes;
+        return sizeof(header) + cnt_numbers * sizeof(uint32_t) + described.cnt_elements + described.cnt_type_chars;
+    }
+
+    template<typename T>
+    void write_array(ofstream &file, const T *array, size_t length) {
+        file.write(reinterpret_cast<const char *>(array), static_cast<streamsize>(length * sizeof(T)));
+    }
+
+    /**
+    * @brief Writes the circuit to a binary snapshot file.
+    *
+    * @throws runtime_error if the file cannot be written.
+    * @param[in] data - circuit to be saved.
+    * @param[in] path - path to the snapshot file.
+    */
+    void save(const circuit &data, const string &path) {
+        circuit_view elements = data.view();
+        vector<uint32_t> node_ids = data.cnt_nodes_plugs.sorted_nodes_below(UINT32_MAX);
+        vector<uint32_t> node_counts;
+        for (uint32_t node : node_ids)
+            node_counts.push_back(data.cnt_nodes_plugs.count(node));
+
+        header written = {};
+        copy_n(MAGIC, sizeof(MAGIC), written.magic);
+        written.version = VERSION;
+        written.byte_order = BYTE_ORDER_MARK;
+        written.cnt_elements = elements.cnt_elements;
+        written.cnt_types = elements.cnt_types;
+        written.cnt_type_chars = elements.type_offsets[elements.cnt_types];
+        written.cnt_nodes = node_ids.size();
+
+        ofstream file(path, ios::binary | ios::trunc);
+        write_array(file, &written, 1);
+        write_array(file, elements.numbers, elements.cnt_elements);
+        write_array(file, elements.types, elements.cnt_elements);
+        write_array(file, elements.terminals, elements.cnt_elements * MAX_TERMINALS);
+        write_array(file, elements.type_offsets, elements.cnt_types + 1);
+        write_array(file, node_ids.data(), node_ids.size());
+        write_array(file, node_counts.data(), node_counts.size());
+        write_array(file, elements.labels, elements.cnt_elements);
+        write_array(file, elements.type_chars, written.cnt_type_chars);
+
+        file.close();
+        if (!file)
+            throw runtime_error("Cannot write snapshot " + path);
+    }
+
+    /**
+    * Snapshot mapped to memory. Its arrays are used in place, nothing is copied or rebuilt.
+    * They are validated once when the snapshot is loaded, so that a damaged or forged file is rejected
+    * instead of making later phases read outside of the mapping.
+    */
+    class mapped_snapshot {
+    private:
+        parallel_reader::mapped_file file;
+        circuit_view elements = {};
+        size_t cnt_nodes = 0;
+        const uint32_t *node_ids = nullptr;
+        const uint32_t *node_counts = nullptr;
+
+        /**
+        * @brief Checks that the arrays describe a circuit which save() could have written: known labels
+        * with their numbers of terminals, numbers and nodes in the range of text input, ids of types
+        * and offsets of types within their arrays, and nodes sorted, each plugged into something.
+        */
+        bool is_consistent(uint64_t cnt_type_chars) const {
+            constexpr uint32_t NUMBER_LIMIT = uint32_t{1} << writer::NUMBER_BITS;
+
+            if (elements.type_offsets[0] != 0 || elements.type_offsets[elements.cnt_types] != cnt_type_chars)
+                return false;
+            for (size_t i = 0; i < elements.cnt_types; i++)
+                if (elements.type_offsets[i] > elements.type_offsets[i + 1])
+                    return false;
+
+            for (size_t i = 0; i < elements.cnt_elements; i++) {
+                int terminals = scanner::terminals_of_label(elements.labels[i]);
+                if (terminals == 0 || elements.numbers[i] >= NUMBER_LIMIT || elements.types[i] >= elements.cnt_types)
+                    return false;
+                const uint32_t *nodes = &elements.terminals[i * MAX_TERMINALS];
+                for (int j = 0; j < MAX_TERMINALS; j++)
+                    if (j < terminals ? nodes[j] >= NUMBER_LIMIT : nodes[j] != NO_NODE)
+                        return false;
+                if (all_of(nodes + 1, nodes + terminals, [nodes](uint32_t node) { return node == nodes[0]; }))
+                    return false;
+            }
+
+            for (size_t i = 0; i < cnt_nodes; i++)
+                if (node_ids[i] >= NUMBER_LIMIT || node_counts[i] == 0 || (i > 0 && node_ids[i - 1] >= node_ids[i]))
+                    return false;
+            return true;
+        }
+
+    public:
+        /**
+        * @brief Maps snapshot file to memory.
+        *
+        * @throws runtime_error if the file cannot be mapped or is not a snapshot of this version.
+        * @param[in] path - path to the snapshot file.
+        */
+        explicit mapped_snapshot(const string &path) : file(path) {
+            string_view contents = file.contents();
+            const header *read = reinterpret_cast<const header *>(contents.data());
+
+            // Counts are bounded by the size first, so that the size computed from them cannot overflow.
+            if (contents.size() < sizeof(header) || !equal(MAGIC, MAGIC + sizeof(MAGIC), read->magic)
+                || read->version != VERSION || read->byte_order != BYTE_ORDER_MARK
+                || max({read->cnt_elements, read->cnt_types, read->cnt_type_chars, read->cnt_nodes}) > contents.size()
+                || file_size(*read) != contents.size())
+                throw runtime_error("File " + path + " is not a correct snapshot");
+
+            const uint32_t *numbers = reinterpret_cast<const uint32_t *>(read + 1);
+            elements.cnt_elements = read->cnt_elements;
+            elements.cnt_types = read->cnt_types;
+            elements.numbers = numbers;
+            elements.types = (numbers += read->cnt_elements);
+            elements.terminals = (numbers += read->cnt_elements);
+            elements.type_offsets = (numbers += read->cnt_elements * MAX_TERMINALS);
+            node_ids = (numbers += read->cnt_types + 1);
+            node_counts = (numbers += read->cnt_nodes);
+            elements.labels = reinterpret_cast<const char *>(numbers + read->cnt_nodes);
+            elements.type_chars = elements.labels + read->cnt_elements;
+            cnt_nodes = read->cnt_nodes;
+
+            if (!is_consistent(read->cnt_type_chars))
+                throw runtime_error("File " + path + " is not a correct snapshot");
+        }
+
+        const circuit_view &view() const {
+            return elements;
+        }
+
+        /**
+        * @brief Returns sorted nodes connected to one or less element, see writer::unconnected_nodes().
+        */
+        vector<uint32_t> unconnected_nodes() const {
+            stats::phase_timer timer(stats::warnings_emission);
+            vector<uint32_t> unconnected;
+
+            if (cnt_nodes == 0 || node_ids[0] != 0)
+                unconnected.push_back(0);
+            for (size_t i = 0; i < cnt_nodes; i++)
+                if (node_counts[i] < 2)
+                    unconnected.push_back(node_ids[i]);
+            return unconnected;
+        }
+
+        size_t cnt_distinct_nodes() const {
+            return cnt_nodes;
+        }
+    };
+} // End of namespace snapshot.
+
+namespace connectivity {
+    using namespace circuit_structures;
+
+    /**
+    * Union-find over dense node indices, with union by size and path halving.
+    */
+    class disjoint_sets {
+    private:
+        vector<uint32_t> parents;
+        vector<uint32_t> sizes;
+
+    public:
+        explicit disjoint_sets(size_t cnt_sets) : parents(cnt_sets), sizes(cnt_sets, 1) {
+            for (size_t i = 0; i < cnt_sets; i++)
+                parents[i] = static_cast<uint32_t>(i);
+        }
+
+        uint32_t find(uint32_t set) {
+            while (parents[set] != set)
+                set = parents[set] = parents[parents[set]];
+            return set;
+        }
+
+        void unite(uint32_t a, uint32_t b) {
+            a = find(a);
+            b = find(b);
+            if (a == b)
+                return;
+            if (sizes[a] < sizes[b])
+                swap(a, b);
+            parents[b] = a;
+            sizes[a] += sizes[b];
+        }
+    };
+
+    /**
+    * @brief Formats connectivity report of the circuit: its sub-circuits (sets of nodes joined by
+    * elements, ordered by their smallest node), power sources not connected to the ground (node 0)
+    * and the histogram of node fan-out (number of elements plugged into a node).
+    * Nodes are renumbered densely, every element becomes at most two edges of a compact edge list
+    * and edges are merged by union-find, so the whole analysis takes near-linear time in number of terminals.
+    *
+    * @param data[in] - view of the circuit to be analysed.
+    * @return Formatted report.
+    */
+    string format_report(const circuit_view &data) {
+        // Terminals paired with their positions are sorted by node, so runs of equal nodes get consecutive
+        // dense indices in one pass. The ground is always present, with no position.
+        constexpr uint32_t NO_POSITION = UINT32_MAX;
+        vector<pair<uint32_t, uint32_t>> occurrences(1, {0, NO_POSITION});
+        occurrences.reserve(data.cnt_elements * MAX_TERMINALS + 1);
+        for (size_t i = 0; i < data.cnt_elements * MAX_TERMINALS; i++)
+            if (data.terminals[i] != NO_NODE)
+                occurrences.emplace_back(data.terminals[i], static_cast<uint32_t>(i));
+        radix_sort(occurrences, [](const pair<uint32_t, uint32_t> &occurrence) { return occurrence.first; });
+
+        vector<uint32_t> nodes; /**< Sorted distinct nodes, the ground first. */
+        vector<uint32_t> indices(data.cnt_elements * MAX_TERMINALS, NO_NODE); /**< Dense index of each terminal. */
+        for (const pair<uint32_t, uint32_t> &occurrence : occurrences) {
+            if (nodes.empty() || nodes.back() != occurrence.first)
+                nodes.push_back(occurrence.first);
+            if (occurrence.second != NO_POSITION)
+                indices[occurrence.second] = static_cast<uint32_t>(nodes.size() - 1);
+        }
+        occurrences = {};
+
+        vector<pair<uint32_t, uint32_t>> edges;
+        vector<uint32_t> fan_out(nodes.size(), 0);
+        edges.reserve(data.cnt_elements * (MAX_TERMINALS - 1));
+        for (size_t i = 0; i < data.cnt_elements; i++) {
+            const uint32_t *terminals = &data.terminals[i * MAX_TERMINALS];
+            const uint32_t *terminal_indices = &indices[i * MAX_TERMINALS];
+
+            for (int j = 0; j < MAX_TERMINALS && terminals[j] != NO_NODE; j++) {
+                if (find(terminals, terminals + j, terminals[j]) == terminals + j)
+                    fan_out[terminal_indices[j]]++;
+                if (j > 0)
+                    edges.emplace_back(terminal_indices[0], terminal_indices[j]);
+            }
+        }
+
+        disjoint_sets components(nodes.size());
+        for (const pair<uint32_t, uint32_t> &edge : edges)
+            components.unite(edge.first, edge.second);
+
+        // Sub-circuits are numbered in order of their smallest nodes.
+        vector<uint32_t> component_of(nodes.size());
+        vector<uint32_t> component_of_root(nodes.size(), UINT32_MAX);
+        vector<uint32_t> cnt_component_nodes, cnt_component_elements, smallest_nodes;
+        for (uint32_t i = 0; i < nodes.size(); i++) {
+            uint32_t root = components.find(i);
+            if (component_of_root[root] == UINT32_MAX) {
+                component_of_root[root] = static_cast<uint32_t>(smallest_nodes.size());
+                smallest_nodes.push_back(nodes[i]);
+                cnt_component_nodes.push_back(0);
+                cnt_component_elements.push_back(0);
+            }
+            component_of[i] = component_of_root[root];
+            cnt_component_nodes[component_of[i]]++;
+        }
+
+        vector<uint32_t> floating_sources;
+        uint32_t ground_component = component_of[0];
+        for (size_t i = 0; i < data.cnt_elements; i++) {
+            uint32_t component = component_of[indices[i * MAX_TERMINALS]];
+            cnt_component_elements[component]++;
+            if (data.labels[i] == 'E' && component != ground_component)
+                floating_sources.push_back(data.numbers[i]);
+        }
+        sort(floating_sources.begin(), floating_sources.end());
+
+        string buffer = "Sub-circuits: ";
+        writer::append_number(buffer, static_cast<uint32_t>(smallest_nodes.size()));
+        buffer += '\n';
+        for (uint32_t i = 0; i < smallest_nodes.size(); i++) {
+            buffer += "Sub-circuit ";
+            writer::append_number(buffer, i + 1);
+            buffer += " (smallest node ";
+            writer::append_number(buffer, smallest_nodes[i]);
+            buffer += "): ";
+            writer::append_number(buffer, cnt_component_nodes[i]);
+            buffer += " node(s), ";
+            writer::append_number(buffer, cnt_component_elements[i]);
+            buffer += " element(s)\n";
+        }
+
+        for (size_t i = 0; i < floating_sources.size(); i++) {
+            buffer += (i == 0 ? "Floating power source(s): E" : ", E");
+            writer::append_number(buffer, floating_sources[i]);
+        }
+        if (!floating_sources.empty())
+            buffer += '\n';
+
+        vector<uint32_t> histogram;
+        for (uint32_t degree : fan_out) {
+            if (degree >= histogram.size())
+                histogram.resize(degree + 1, 0);
+            histogram[degree]++;
+        }
+        for (uint32_t degree = 0; degree < histogram.size(); degree++) {
+            if (histogram[degree] == 0)
+                continue;
+            buffer += "Fan-out ";
+            writer::append_number(buffer, degree);
+            buffer += ": ";
+            writer::append_number(buffer, histogram[degree]);
+            buffer += " node(s)\n";
+        }
+
+        return buffer;
+    }
+
+    /**
+    * @brief Lists connectivity report of the circuit, see format_report().
+    *
+    * @param data[in] - view of the circuit to be analysed.
+    */
+    void list_report(const circuit_view &data) {
+        string buffer = format_report(data);
+
+        cout.write(buffer.data(), static_cast<streamsize>(buffer.size()));
+        cout.flush();
+    }
+} // End of namespace connectivity.
+
+namespace query {
+    using namespace circuit_structures;
+
+    /**
+    * Indexes of a circuit answering which elements are plugged into a node and which elements have
+    * a type. Both are kept in compressed sparse row form: elements of row r occupy
+    * elements[offsets[r], offsets[r + 1]), ordered like in the list of elements (by label, then number).
+    */
+    class circuit_index {
+    private:
+        const circuit_view data;
+        unordered_map<uint32_t, uint32_t> node_rows; /**< {node} -> {row in node_offsets} */
+        vector<uint32_t> node_offsets;
+        vector<uint32_t> node_elements;
+        unordered_map<string_view, uint32_t> type_ids; /**< {type} -> {id of type, its row in type_offsets} */
+        vector<uint32_t> type_offsets;
+        vector<uint32_t> type_elements;
+
+        /**
+        * @brief Fills CSR arrays from rows given for elements in order of listing, counting sort by row.
+        */
+        static void build_rows(const vector<pair<uint32_t, uint32_t>> &entries, size_t cnt_rows,
+                               vector<uint32_t> &offsets, vector<uint32_t> &elements) {
+            offsets.assign(cnt_rows + 1, 0);
+            for (const auto &entry : entries)
+                offsets[entry.first + 1]++;
+            for (size_t row = 1; row <= cnt_rows; row++)
+                offsets[row] += offsets[row - 1];
+
+            vector<uint32_t> positions(offsets.begin(), offsets.end() - 1);
+            elements.resize(entries.size());
+            for (const auto &entry : entries)
+                elements[positions[entry.first]++] = entry.second;
+        }
+
+        void append_row(string &buffer, const vector<uint32_t> &offsets, const vector<uint32_t> &elements,
+                        uint32_t row) const {
+            for (uint32_t i = offsets[row]; i < offsets[row + 1]; i++) {
+                buffer += (i == offsets[row] ? " " : ", ");
+                buffer += data.labels[elements[i]];
+                writer::append_number(buffer, data.numbers[elements[i]]);
+            }
+        }
+
+    public:
+        /**
+        * @brief Builds indexes of the circuit in O(n log n) time, n being the number of elements.
+        *
+        * @param[in] data - view of the circuit, it has to outlive the index.
+        */
+        explicit circuit_index(const circuit_view &data) : data(data) {
+            vector<pair<uint64_t, uint32_t>> order(data.cnt_elements); /**< ((label's rank, number), element) */
+            for (uint32_t i = 0; i < data.cnt_elements; i++)
+                order[i] = {(label_rank(data.labels[i]) << writer::NUMBER_BITS) | data.numbers[i], i};
+            sort(order.begin(), order.end());
+
+            vector<pair<uint32_t, uint32_t>> node_entries, type_entries;
+            node_entries.reserve(data.cnt_elements * MAX_TERMINALS);
+            type_entries.reserve(data.cnt_elements);
+            node_rows.reserve(data.cnt_elements);
+            for (const auto &ordered : order) {
+                uint32_t element = ordered.second;
+                const uint32_t *terminals = data.terminals + size_t(element) * MAX_TERMINALS;
+
+                for (int i = 0; i < MAX_TERMINALS; i++) {
+                    bool seen = terminals[i] == NO_NODE;
+                    for (int j = 0; j < i; j++)
+                        seen = seen || terminals[j] == terminals[i];
+                    if (!seen) {
+                        auto row = node_rows.emplace(terminals[i], static_cast<uint32_t>(node_rows.size())).first;
+                        node_entries.emplace_back(row->second, element);
+                    }
+                }
+                type_entries.emplace_back(data.types[element], element);
+            }
+
+            build_rows(node_entries, node_rows.size(), node_offsets, node_elements);
+            build_rows(type_entries, data.cnt_types, type_offsets, type_elements);
+            for (uint32_t id = 0; id < data.cnt_types; id++)
+                type_ids.emplace(data.type_of(id), id);
+        }
+
+        /**
+        * @brief Appends line listing elements plugged into the node, in O(result) time.
+        */
+        void answer_node(string &buffer, uint32_t node) const {
+            buffer += "Node ";
+            writer::append_number(buffer, node);
+            buffer += ':';
+
+            auto row = node_rows.find(node);
+            if (row == node_rows.end())
+                buffer += " none";
+            else
+                append_row(buffer, node_offsets, node_elements, row->second);
+            buffer += '\n';
+        }
+
+        /**
+        * @brief Appends line listing elements of the type, in O(result) time.
+        */
+        void answer_type(string &buffer, string_view type) const {
+            buffer += "Type ";
+            buffer += type;
+            buffer += ':';
+
+            auto id = type_ids.find(type);
+            if (id == type_ids.end())
+                buffer += " none";
+            else
+                append_row(buffer, type_offsets, type_elements, id->second);
+            buffer += '\n';
+        }
+    };
+
+    /**
+    * @brief Answers queries, one per line: "node N" lists elements plugged into node N, "type T" lists
+    * elements of type T. Empty lines are skipped, incorrect ones are reported like incorrect lines
+    * of the circuit.
+    *
+    * @param[in] index - index of the queried circuit.
+    * @param[in, out] queries - stream with queries.
+    * @param[in, out] errors - stream receiving errors.
+    * @return Answers, one line per query.
+    */
+    string answer_queries(const circuit_index &index, istream &queries, ostream &errors = cerr) {
+        string buffer, line;
+        int cnt_line = 0;
+
+        while (getline(queries, line)) {
+            cnt_line++;
+            size_t pos = 0;
+            string_view kind = scanner::next_token(line, pos);
+            string_view argument = scanner::next_token(line, pos);
+            int node;
+
+            if (kind.empty() && argument.empty())
+                continue;
+            if (!scanner::next_token(line, pos).empty())
+                errors << reader::wrong_input_exception(line, cnt_line).what() << endl;
+            else if (kind == "node" && scanner::parse_number(argument, node))
+                index.answer_node(buffer, static_cast<uint32_t>(node));
+            else if (kind == "type" && scanner::is_correct_type(argument))
+                index.answer_type(buffer, argument);
+            else
+                errors << reader::wrong_input_exception(line, cnt_line).what() << endl;
+        }
+
+        return buffer;
+    }
+
+    /**
+    * @brief Indexes the circuit and prints answers to queries from the file.
+    *
+    * @throws runtime_error if the query file cannot be opened.
+    * @param[in] data - view of the queried circuit.
+    * @param[in] path - path to the file with queries.
+    */
+    void run(const circuit_view &data, const string &path) {
+        ifstream queries(path);
+        if (!queries)
+            throw runtime_error("Cannot open file " + path);
+
+        circuit_index index(data);
+        string buffer = answer_queries(index, queries);
+        cout.write(buffer.data(), static_cast<streamsize>(buffer.size()));
+        cout.flush();
+    }
+} // End of namespace query.
+
+namespace diff {
+    using namespace circuit_structures;
+
+    /**
+    * @brief Appends description of the element: its tag, type and nodes, like in the netlist.
+    */
+    void append_element(string &buffer, const circuit &data, uint32_t index) {
+        buffer += data.elements.labels[index];
+        writer::append_number(buffer, data.elements.numbers[index]);
+        buffer += ' ';
+        buffer += data.types.type_of(data.elements.types[index]);
+        for (int i = 0; i < MAX_TERMINALS; i++) {
+            uint32_t node = data.elements.terminals[size_t(index) * MAX_TERMINALS + i];
+            if (node != NO_NODE) {
+                buffer += ' ';
+                writer::append_number(buffer, node);
+            }
+        }
+    }
+
+    void append_nodes(string &buffer, const uint32_t *terminals) {
+        for (int i = 0; i < MAX_TERMINALS && terminals[i] != NO_NODE; i++) {
+            buffer += ' ';
+            writer::append_number(buffer, terminals[i]);
+        }
+    }
+
+    /**
+    * @brief Returns key ordering elements like in the list of elements: by label, then by number.
+    */
+    uint64_t listing_key(char label, uint32_t number) {
+        return (label_rank(label) << writer::NUMBER_BITS) | number;
+    }
+
+    /**
+    * @brief Formats differences between two circuits, one line per change:
+    * "+ TAG TYPE NODES" for an added element, "- TAG TYPE NODES" for a removed one,
+    * "~ TAG type OLD -> NEW" for a retyped one, "~ TAG nodes OLD -> NEW" for a rewired one
+    * (elements are matched by tags and ordered like in the list of elements), followed by
+    * "Quantity LABEL TYPE: OLD -> NEW" for every line of the list whose number of elements changed.
+    * Elements are matched through hash tables of tags and types are translated between the circuits
+    * once per type, so apart from sorting the changes the diff takes linear time.
+    *
+    * @param[in] old_data - old version of the circuit.
+    * @param[in] new_data - new version of the circuit.
+    * @return Formatted differences, empty if circuits have the same elements.
+    */
+    string format_diff(const circuit &old_data, const circuit &new_data) {
+        const element_table &old_elements = old_data.elements, &new_elements = new_data.elements;
+
+        // Types of the old circuit get ids of the new one, types missing there get ids past them.
+        auto cnt_new_types = static_cast<uint32_t>(new_data.types.size());
+        vector<uint32_t> translated(old_data.types.size());
+        for (uint32_t id = 0; id < translated.size(); id++) {
+            uint32_t new_id = new_data.types.find(old_data.types.type_of(id));
+            translated[id] = (new_id == type_interner::NO_TYPE ? cnt_new_types + id : new_id);
+        }
+        auto type_name = [&](uint32_t id) {
+            return id < cnt_new_types ? new_data.types.type_of(id) : old_data.types.type_of(id - cnt_new_types);
+        };
+
+        vector<pair<uint64_t, string>> changes; /**< (listing key, sign) of changed elements */
+        unordered_map<uint64_t, pair<uint32_t, uint32_t>> quantities; /**< {(label, type)} -> {old, new} */
+        quantities.reserve(old_data.types.size() + new_data.types.size());
+
+        for (uint32_t i = 0; i < old_elements.size(); i++) {
+            char label = old_elements.labels[i];
+            uint32_t type = translated[old_elements.types[i]];
+            quantities[tag_key(label, type)].first++;
+
+            auto match = new_data.tags.find(tag_key(label, old_elements.numbers[i]));
+            if (match == new_data.tags.end()) {
+                string line = "- ";
+                append_element(line, old_data, i);
+                changes.emplace_back(listing_key(label, old_elements.numbers[i]), move(line));
+                continue;
+            }
+
+            uint32_t j = match->second;
+            const uint32_t *old_terminals = &old_elements.terminals[size_t(i) * MAX_TERMINALS];
+            const uint32_t *new_terminals = &new_elements.terminals[size_t(j) * MAX_TERMINALS];
+            string line;
+            if (type != new_elements.types[j]) {
+                line += "~ ";
+                line += label;
+                writer::append_number(line, old_elements.numbers[i]);
+                line += " type ";
+                line += type_name(type);
+                line += " -> ";
+                line += type_name(new_elements.types[j]);
+            }
+            if (!equal(old_terminals, old_terminals + MAX_TERMINALS, new_terminals)) {
+                if (!line.empty())
+                    line += '\n';
+                line += "~ ";
+                line += label;
+                writer::append_number(line, old_elements.numbers[i]);
+                line += " nodes";
+                append_nodes(line, old_terminals);
+                line += " ->";
+                append_nodes(line, new_terminals);
+            }
+            if (!line.empty())
+                changes.emplace_back(listing_key(label, old_elements.numbers[i]), move(line));
+        }
+
+        for (uint32_t j = 0; j < new_elements.size(); j++) {
+            char label = new_elements.labels[j];
+            quantities[tag_key(label, new_elements.types[j])].second++;
+
+            if (old_data.tags.count(tag_key(label, new_elements.numbers[j])) == 0) {
+                string line = "+ ";
+                append_element(line, new_data, j);
+                changes.emplace_back(listing_key(label, new_elements.numbers[j]), move(line));
+            }
+        }
+
+        // Removal and addition of the same tag cannot happen, so keys of changes are unique.
+        sort(changes.begin(), changes.end());
+        string buffer;
+        for (const auto &change : changes) {
+            buffer += change.second;
+            buffer += '\n';
+        }
+
+        vector<tuple<uint64_t, string_view, uint64_t>> changed_lines; /**< (label's rank, type, group) */
+        for (const auto &quantity : quantities) {
+            if (quantity.second.first == quantity.second.second)
+                continue;
+            auto label = static_cast<char>(quantity.first >> 32);
+            changed_lines.emplace_back(label_rank(label), type_name(static_cast<uint32_t>(quantity.first)),
+                                       quantity.first);
+        }
+        sort(changed_lines.begin(), changed_lines.end());
+        for (const auto &changed : changed_lines) {
+            const auto &counts = quantities[get<2>(changed)];
+            buffer += "Quantity ";
+            buffer += static_cast<char>(get<2>(changed) >> 32);
+            buffer += ' ';
+            buffer += get<1>(changed);
+            buffer += ": ";
+            writer::append_number(buffer, counts.first);
+            buffer += " -> ";
+            writer::append_number(buffer, counts.second);
+            buffer += '\n';
+        }
+
+        return buffer;
+    }
+
+    /**
+    * @brief Reads circuit from the file, printing its errors prefixed with the path of the file.
+    *
+    * @throws runtime_error if file cannot be read.
+    */
+    circuit read_version(const string &path, unsigned cnt_threads) {
+        ostringstream errors;
+        circuit data = parallel_reader::read_file(path, cnt_threads, errors);
+
+        istringstream lines(errors.str());
+        string line;
+        while (getline(lines, line))
+            cerr << path << ": " << line << endl;
+        return data;
+    }
+
+    /**
+    * @brief Reads two versions of a circuit and prints differences between them, see format_diff().
+    *
+    * @throws runtime_error if any of the files cannot be read.
+    * @param[in] old_path - file with the old version.
+    * @param[in] new_path - file with the new version.
+    * @param[in] cnt_threads - number of threads reading every file.
+    */
+    void run(const string &old_path, const string &new_path, unsigned cnt_threads) {
+        circuit old_data = read_version(old_path, cnt_threads);
+        circuit new_data = read_version(new_path, cnt_threads);
+
+        string buffer = format_diff(old_data, new_data);
+        cout.write(buffer.data(), static_cast<streamsize>(buffer.size()));
+        cout.flush();
+    }
+} // End of namespace diff.
+
+namespace hierarchy {
+    using namespace circuit_structures;
+
+    /**
+    * Use of a block inside another one: "X<number> NAME NODES", nodes are plugged into ports of the block.
+    */
+    struct instance {
+        uint32_t block;
+        vector<uint32_t> nodes;
+    };
+
+    /**
+    * Subcircuit defined between ".subckt NAME PORTS" and ".ends", or the top level of the design.
+    * Nodes of a block are local to it, except for the ground (node 0) which is shared by the whole design.
+    */
+    struct block {
+        string name;
+        vector<uint32_t> ports;
+        circuit elements; /**< Elements defined directly in the block. */
+        vector<instance> instances;
+        unordered_map<uint32_t, uint32_t> instance_tags; /**< {number of instance's tag} -> {index in instances} */
+        unordered_map<uint32_t, uint32_t> slots; /**< {local node other than 0} -> {slot}, ports come first */
+        /**
+        * Sorted nodes, only ports and the ground, of elements plugged into nothing else (in instances too).
+        * An instance tying all nodes of a group together would make such an element single node.
+        */
+        vector<vector<uint32_t>> tied_groups;
+    };
+
+    /**
+    * Hierarchical circuit. Blocks have to be defined before they are instantiated, so they form
+    * an acyclic graph whose topological order is the order of definitions. Numbers of elements of
+    * every block are computed once, with instances multiplied rather than expanded, so listing
+    * quantities takes time proportional to the size of definitions, not of the flattened design.
+    * So are plugs of nodes, so the warning takes that time plus time proportional to its length.
+    */
+    class design {
+    private:
+        static constexpr uint32_t TOP = 0; /**< Index of the top level in blocks. */
+        static constexpr uint32_t MAX_NUMBER = 999999999; /**< Largest number allowed in tags and nodes. */
+        static constexpr size_t CNT_LABELS = 256; /**< Counters of flattened elements are indexed by labels. */
+
+        vector<block> blocks;
+        unordered_map<string, uint32_t> block_ids; /**< {name of block} -> {index in blocks} */
+        type_interner types; /**< Types of the whole design. */
+        unordered_map<uint64_t, uint64_t> quantities; /**< Result of count_elements(), once counted. */
+        vector<uint64_t> line_order; /**< Keys of quantities in order of first occurrence in the flattened design. */
+        bool are_quantities_counted = false;
+
+        /**
+        * @brief Checks that the instance makes no element of the instantiated block single node, and adds
+        * groups of the block which remain plugged into ports of the parent (or the ground) to the parent.
+        *
+        * @return True if no group of the instantiated block has all its nodes tied together.
+        */
+        bool add_tied_groups(block &parent, const instance &added) const {
+            const block &child = blocks[added.block];
+            vector<vector<uint32_t>> inherited;
+            for (const vector<uint32_t> &group : child.tied_groups) {
+                vector<uint32_t> mapped;
+                bool only_ports = true;
+                for (uint32_t node : group) {
+                    uint32_t parent_node = node == 0 ? 0 : added.nodes[child.slots.at(node)];
+                    only_ports = only_ports && (parent_node == 0 || parent.slots.count(parent_node) > 0);
+                    mapped.push_back(parent_node);
+                }
+                sort(mapped.begin(), mapped.end());
+                mapped.erase(unique(mapped.begin(), mapped.end()), mapped.end());
+                if (mapped.size() < 2)
+                    return false;
+                if (only_ports)
+                    inherited.push_back(move(mapped));
+            }
+
+            // Nodes of the top level are never tied later, so its groups are not needed.
+            if (&parent != &blocks[TOP])
+                parent.tied_groups.insert(parent.tied_groups.end(), inherited.begin(), inherited.end());
+            return true;
+        }
+
+        /**
+        * @brief Parses number of the instance and its nodes, checking them against the instantiated block.
+        *
+        * @return True if instance line is correct and has been added to the block.
+        */
+        bool add_instance(block &parent, string_view line) {
+            size_t pos = 0;
+            string_view tag = scanner::next_token(line, pos);
+            auto found = block_ids.find(string(scanner::next_token(line, pos)));
+            int number;
+            if (!scanner::parse_number(tag.substr(1), number) || found == block_ids.end()
+                || parent.instance_tags.count(static_cast<uint32_t>(number)) > 0)
+                return false;
+
+            instance added = {found->second, {}};
+            int node;
+            for (string_view token = scanner::next_token(line, pos); !token.empty();
+                 token = scanner::next_token(line, pos)) {
+                if (!scanner::parse_number(token, node))
+                    return false;
+                added.nodes.push_back(static_cast<uint32_t>(node));
+            }
+            if (added.nodes.size() != blocks[added.block].ports.size() || !add_tied_groups(parent, added))
+                return false;
+
+            parent.instance_tags.emplace(static_cast<uint32_t>(number), static_cast<uint32_t>(parent.instances.size()));
+            parent.instances.push_back(move(added));
+            return true;
+        }
+
+        /**
+        * @brief Opens definition of a new block: ".subckt NAME PORTS", ports being distinct non-zero nodes.
+        *
+        * @return True if the definition is correct and has been opened.
+        */
+        bool open_block(string_view line) {
+            size_t pos = 0;
+            scanner::next_token(line, pos);
+            string name(scanner::next_token(line, pos));
+            if (name.empty() || block_ids.count(name) > 0)
+                return false;
+
+            block opened;
+            opened.name = name;
+            int node;
+            for (string_view token = scanner::next_token(line, pos); !token.empty();
+                 token = scanner::next_token(line, pos)) {
+                if (!scanner::parse_number(token, node) || node == 0
+                    || !opened.slots.emplace(node, static_cast<uint32_t>(opened.ports.size())).second)
+                    return false;
+                opened.ports.push_back(static_cast<uint32_t>(node));
+            }
+
+            blocks.push_back(move(opened));
+            return true;
+        }
+
+        /**
+        * @brief Adds groups of elements plugged only into ports and the ground, then assigns slots
+        * to internal nodes of the block, after the ports.
+        */
+        void close_block(block &closed) {
+            const element_table &elements = closed.elements.elements;
+            for (size_t i = 0; i < elements.size(); i++) {
+                vector<uint32_t> group;
+                for (int j = 0; j < MAX_TERMINALS; j++) {
+                    uint32_t node = elements.terminals[i * MAX_TERMINALS + j];
+                    if (node != NO_NODE)
+                        group.push_back(node);
+                }
+                if (all_of(group.begin(), group.end(),
+                           [&closed](uint32_t node) { return node == 0 || closed.slots.count(node) > 0; })) {
+                    sort(group.begin(), group.end());
+                    group.erase(unique(group.begin(), group.end()), group.end());
+                    closed.tied_groups.push_back(move(group));
+                }
+            }
+            sort(closed.tied_groups.begin(), closed.tied_groups.end());
+            closed.tied_groups.erase(unique(closed.tied_groups.begin(), closed.tied_groups.end()),
+                                     closed.tied_groups.end());
+
+            auto assign = [&closed](uint32_t node) {
+                if (node != 0 && node != NO_NODE)
+                    closed.slots.emplace(node, static_cast<uint32_t>(closed.slots.size()));
+            };
+            for (uint32_t node : closed.elements.elements.terminals)
+                assign(node);
+            for (const instance &used : closed.instances)
+                for (uint32_t node : used.nodes)
+                    assign(node);
+        }
+
+        /**
+        * Instance being expanded by flatten(): its block, nodes of the flattened design which slots
+        * of the block are mapped to, and the next instance of the block to be expanded.
+        */
+        struct expansion {
+            uint32_t block;
+            vector<uint32_t> nodes;
+            size_t next_instance = 0;
+        };
+
+        uint32_t map_node(const expansion &expanded, uint32_t node) const {
+            return expanded.block == TOP || node == 0 ? node : expanded.nodes[blocks[expanded.block].slots.at(node)];
+        }
+
+        /**
+        * @brief Starts expansion of an instance of the block: ports become nodes of the instance, internal
+        * nodes get fresh numbers, and elements defined directly in the block are appended to the buffer,
+        * as lines of a flat netlist. The ground stays 0.
+        */
+        expansion start_expansion(uint32_t id, vector<uint32_t> port_nodes, uint32_t &next_node,
+                                  uint32_t (&next_number)[CNT_LABELS], string &buffer, ostream &output) const {
+            const block &expanded_block = blocks[id];
+            expansion expanded = {id, move(port_nodes)};
+            while (id != TOP && expanded.nodes.size() < expanded_block.slots.size()) {
+                if (next_node > MAX_NUMBER)
+                    throw runtime_error("Flattened design has too many nodes");
+                expanded.nodes.push_back(next_node++);
+            }
+
+            const element_table &elements = expanded_block.elements.elements;
+            for (size_t i = 0; i < elements.size(); i++) {
+                uint32_t &number = next_number[static_cast<unsigned char>(elements.labels[i])];
+                if (number > MAX_NUMBER)
+                    throw runtime_error("Flattened design has too many elements");
+                buffer += elements.labels[i];
+                writer::append_number(buffer, number++);
+                buffer += ' ';
+                buffer += expanded_block.elements.types.type_of(elements.types[i]);
+                for (int j = 0; j < MAX_TERMINALS; j++) {
+                    uint32_t node = elements.terminals[i * MAX_TERMINALS + j];
+                    if (node != NO_NODE) {
+                        buffer += ' ';
+                        writer::append_number(buffer, map_node(expanded, node));
+                    }
+                }
+                buffer += '\n';
+            }
+
+            if (buffer.size() > (1u << 20)) {
+                output.write(buffer.data(), static_cast<streamsize>(buffer.size()));
+                buffer.clear();
+            }
+            return expanded;
+        }
+
+        /**
+        * @brief Returns a * b + c, the count of flattened design it is a part of.
+        *
+        * @throws runtime_error if the result does not fit in 64 bits.
+        */
+        static uint64_t multiply_add(uint64_t a, uint64_t b, uint64_t c) {
+            if (b != 0 && a > (UINT64_MAX - c) / b)
+                throw runtime_error("Flattened design is too big to be counted");
+            return a * b + c;
+        }
+
+        /**
+        * @brief Counts elements of the flattened design: {(label, id of type in types)} -> {count}.
+        * Totals of a block are its own elements plus totals of instantiated blocks multiplied by
+        * the number of instances, computed once per block in order of definitions. Types of a block
+        * are interned once each. Keys are also ordered by their first occurrence in the flattened
+        * design, where elements of a block come before elements of its instances, into line_order.
+        * The result is kept, so later calls return it without counting again.
+        *
+        * @throws runtime_error if a count does not fit in 64 bits.
+        */
+        const unordered_map<uint64_t, uint64_t> &count_elements() {
+            if (are_quantities_counted)
+                return quantities;
+
+            vector<unordered_map<uint64_t, uint64_t>> totals(blocks.size());
+            vector<vector<uint64_t>> orders(blocks.size()); /**< Keys of totals by first occurrence. */
+            for (uint32_t id = 1; id <= blocks.size(); id++) {
+                uint32_t current = (id == blocks.size() ? TOP : id);
+                const block &counted = blocks[current];
+                unordered_map<uint64_t, uint64_t> &total = totals[current];
+                vector<uint64_t> &order = orders[current];
+
+                const element_table &elements = counted.elements.elements;
+                vector<uint32_t> design_types(counted.elements.types.size(), type_interner::NO_TYPE);
+                for (size_t i = 0; i < elements.size(); i++) {
+                    uint32_t &type = design_types[elements.types[i]];
+                    if (type == type_interner::NO_TYPE)
+                        type = types.intern(counted.elements.types.type_of(elements.types[i]));
+                    uint64_t key = tag_key(elements.labels[i], type);
+                    if (total[key]++ == 0)
+                        order.push_back(key);
+                }
+
+                unordered_map<uint32_t, uint64_t> multiplicity; /**< {block} -> {number of its instances} */
+                for (const instance &used : counted.instances)
+                    if (multiplicity[used.block]++ == 0)
+                        for (uint64_t key : orders[used.block])
+                            if (total.emplace(key, 0).second)
+                                order.push_back(key);
+                for (const auto &child : multiplicity)
+                    for (const auto &entry : totals[child.first]) {
+                        uint64_t &count = total[entry.first];
+                        count = multiply_add(entry.second, child.second, count);
+                    }
+            }
+            quantities = move(totals[TOP]);
+            line_order = move(orders[TOP]);
+            are_quantities_counted = true;
+            return quantities;
+        }
+
+        /**
+        * @brief Counts nodes of the flattened design with an element plugged in. For every block it finds
+        * which of its nodes are plugged, directly or through ports of instances, and counts plugged internal
+        * nodes of all its instances, which are distinct in every instance. The ground is shared by all.
+        *
+        * @throws runtime_error if the count does not fit in 64 bits.
+        */
+        uint64_t count_nodes() const {
+            struct plugged_nodes {
+                vector<bool> slots; /**< Whether a node with given slot is plugged. */
+                bool ground = false;
+                uint64_t cnt_internal = 0; /**< Plugged nodes other than ports and ground, in instances too. */
+            };
+            vector<plugged_nodes> plugged(blocks.size());
+
+            for (uint32_t id = 1; id <= blocks.size(); id++) {
+                uint32_t current = (id == blocks.size() ? TOP : id);
+                const block &counted = blocks[current];
+                plugged_nodes &found = plugged[current];
+                found.slots.assign(counted.slots.size(), false);
+                auto plug = [&](uint32_t node) {
+                    if (node == 0)
+                        found.ground = true;
+                    else if (node != NO_NODE)
+                        found.slots[counted.slots.at(node)] = true;
+                };
+
+                for (uint32_t node : counted.elements.elements.terminals)
+                    plug(node);
+                for (const instance &used : counted.instances) {
+                    const plugged_nodes &child = plugged[used.block];
+                    for (size_t port = 0; port < used.nodes.size(); port++)
+                        if (child.slots[port])
+                            plug(used.nodes[port]);
+                    found.ground = found.ground || child.ground;
+                    found.cnt_internal = multiply_add(child.cnt_internal, 1, found.cnt_internal);
+                }
+                uint64_t cnt_own = static_cast<uint64_t>(count(found.slots.begin() + counted.ports.size(),
+                                                               found.slots.end(), true));
+                found.cnt_internal = multiply_add(cnt_own, 1, found.cnt_internal);
+            }
+            return multiply_add(plugged[TOP].ground ? 1 : 0, 1, plugged[TOP].cnt_internal);
+        }
+
+        /**
+        * Elements of the flattened design plugged into a node, counted up to 2, and the element if there
+        * is one. Elements are identified locally in a block, so that an element reaching a node of the parent
+        * through two ports tied together is counted once.
+        */
+        struct node_plugs {
+            uint32_t cnt = 0;
+            uint32_t element = 0;
+
+            void plug(uint32_t plugged) {
+                if (cnt == 0) {
+                    cnt = 1;
+                    element = plugged;
+                } else if (element != plugged) {
+                    cnt = 2;
+                }
+            }
+        };
+
+        /**
+        * Unconnected nodes of every instance of a block: plugs of its ports and the ground, as seen
+        * by the parent, and sorted slots of its internal nodes with exactly one element plugged in.
+        * Numbers of internal nodes in the whole subtree of an instance are counted like flatten() assigns
+        * them, so that the warning names nodes of the flattened design.
+        */
+        struct block_plugs {
+            vector<node_plugs> ports;
+            node_plugs ground;
+            vector<uint32_t> unconnected;
+            uint64_t cnt_unconnected = 0; /**< Unconnected internal nodes in the subtree of an instance. */
+            uint64_t cnt_internal = 0; /**< Internal nodes in the subtree of an instance, plugged or not. */
+        };
+
+        /**
+        * @brief Finds plugs of nodes of every block, in order of definitions: elements of the block are
+        * numbered 0, 1, ..., and elements of its instances which reach its nodes get the following numbers,
+        * one for every pair of instance and its element.
+        *
+        * @throws runtime_error if a count does not fit in 64 bits.
+        */
+        vector<block_plugs> find_plugs() const {
+            vector<block_plugs> found(blocks.size());
+
+            for (uint32_t id = 1; id <= blocks.size(); id++) {
+                uint32_t current = (id == blocks.size() ? TOP : id);
+                const block &checked = blocks[current];
+                block_plugs &result = found[current];
+                vector<node_plugs> nodes(checked.slots.size());
+                auto node_at = [&](uint32_t node) -> node_plugs & {
+                    return node == 0 ? result.ground : nodes[checked.slots.at(node)];
+                };
+
+                const element_table &elements = checked.elements.elements;
+                for (size_t i = 0; i < elements.size(); i++) {
+                    const uint32_t *terminals = &elements.terminals[i * MAX_TERMINALS];
+                    for (int j = 0; j < MAX_TERMINALS && terminals[j] != NO_NODE; j++)
+                        node_at(terminals[j]).plug(static_cast<uint32_t>(i));
+                }
+
+                auto next_element = static_cast<uint32_t>(elements.size());
+                for (size_t k = 0; k < checked.instances.size(); k++) {
+                    const instance &used = checked.instances[k];
+                    const block_plugs &child = found[used.block];
+                    unordered_map<uint32_t, uint32_t> numbered; /**< {element of child} -> {element of block} */
+                    auto add = [&](node_plugs &target, const node_plugs &plugs) {
+                        if (plugs.cnt == 0)
+                            return;
+                        auto inserted = numbered.emplace(plugs.element, next_element);
+                        if (inserted.second)
+                            next_element++;
+                        target.plug(inserted.first->second);
+                        if (plugs.cnt > 1)
+                            target.cnt = 2;
+                    };
+
+                    for (size_t port = 0; port < used.nodes.size(); port++)
+                        add(node_at(used.nodes[port]), child.ports[port]);
+                    add(result.ground, child.ground);
+                    result.cnt_unconnected = multiply_add(child.cnt_unconnected, 1, result.cnt_unconnected);
+                    result.cnt_internal = multiply_add(child.cnt_internal, 1, result.cnt_internal);
+                }
+
+                size_t first_internal = current == TOP ? 0 : checked.ports.size();
+                result.ports.assign(nodes.begin(), nodes.begin() + static_cast<ptrdiff_t>(first_internal));
+                for (size_t slot = first_internal; slot < nodes.size(); slot++)
+                    if (nodes[slot].cnt == 1)
+                        result.unconnected.push_back(static_cast<uint32_t>(slot));
+                result.cnt_unconnected = multiply_add(result.unconnected.size(), 1, result.cnt_unconnected);
+                result.cnt_internal = multiply_add(nodes.size() - first_internal, 1, result.cnt_internal);
+            }
+            return found;
+        }
+
+    public:
+        design() {
+            blocks.emplace_back();
+        }
+
+        /**
+        * @brief Reads hierarchical circuit, printing errors for incorrect lines. Lines other than
+        * subcircuit definitions (".subckt NAME PORTS", ".ends") and instances ("X<number> NAME NODES")
+        * are elements of the innermost open block, validated just like in a flat circuit. An instance
+        * which ties together all nodes of an element of the instantiated block (at any depth) is incorrect,
+        * as the flattened element would be single node.
+        *
+        * @param[in, out] input - stream with circuit description.
+        * @param[in, out] errors - stream receiving errors.
+        */
+        void read(istream &input = cin, ostream &errors = cerr) {
+            uint32_t current = TOP;
+            int opening_line = 0;
+            string opening;
+            reader::line_batch batch;
+            int cnt_line = 0;
+
+            while (batch.read(input)) {
+                // Lines of a block are checked and added together, timed as insertion.
+                stats::phase_timer timer(stats::insertion);
+                for (size_t i = 0; i < batch.size(); i++) {
+                    const string &line = batch[i];
+                    cnt_line++;
+                    size_t pos = 0;
+                    string_view first = scanner::next_token(line, pos);
+                    bool correct = true;
+
+                    if (first == ".subckt") {
+                        correct = current == TOP && open_block(line);
+                        if (correct) {
+                            current = static_cast<uint32_t>(blocks.size() - 1);
+                            opening_line = cnt_line;
+                            opening = line;
+                        }
+                    } else if (first == ".ends") {
+                        correct = current != TOP && scanner::next_token(line, pos).empty();
+                        if (correct) {
+                            close_block(blocks[current]);
+                            block_ids.emplace(blocks[current].name, current);
+                            current = TOP;
+                        }
+                    } else if (!first.empty() && first[0] == 'X') {
+                        correct = add_instance(blocks[current], line);
+                    } else {
+                        try {
+                            reader::parse_and_add_line(blocks[current].elements, line, cnt_line);
+                        } catch (reader::wrong_input_exception &e) {
+                            errors << e.what() << endl;
+                        }
+                    }
+
+                    if (!correct)
+                        errors << reader::wrong_input_exception(line, cnt_line).what() << endl;
+                }
+            }
+
+            if (current != TOP) {
+                errors << reader::wrong_input_exception(opening, opening_line).what() << endl;
+                blocks.pop_back();
+            }
+            close_block(blocks[TOP]);
+            stats::count_lines(static_cast<uint64_t>(cnt_line));
+        }
+
+        /**
+        * @brief Formats number of elements of every line of the list of elements (label and type)
+        * in the flattened design: "LABEL TYPE: QUANTITY". Lines are ordered like the list of the flattened
+        * design: by labels, then by first occurrences of types, which is where their smallest numbers are.
+        * Tags themselves are not listed, as there are as many of them as elements of the flattened design.
+        *
+        * @throws runtime_error if a quantity does not fit in 64 bits.
+        */
+        string format_quantities() {
+            const unordered_map<uint64_t, uint64_t> &counts = count_elements();
+            vector<uint64_t> lines(line_order);
+            stable_sort(lines.begin(), lines.end(), [](uint64_t a, uint64_t b) {
+                return label_rank(static_cast<char>(a >> 32)) < label_rank(static_cast<char>(b >> 32));
+            });
+
+            string buffer;
+            for (uint64_t key : lines) {
+                buffer += static_cast<char>(key >> 32);
+                buffer += ' ';
+                buffer += types.type_of(static_cast<uint32_t>(key));
+                buffer += ": ";
+                buffer += to_string(counts.at(key));
+                buffer += '\n';
+            }
+            return buffer;
+        }
+
+        /**
+        * @brief Writes the warning about nodes of the flattened design connected to one or less element,
+        * like writer::list_warnings() for a flat circuit, numbering nodes like flatten() does. Only
+        * instances whose subtrees have such nodes are visited, depth first with an explicit stack,
+        * in order of expansion, which is also the ascending order of their numbers.
+        *
+        * @throws runtime_error if a count does not fit in 64 bits.
+        */
+        void list_warnings(ostream &output) const {
+            vector<block_plugs> plugs = find_plugs();
+            const block &top = blocks[TOP];
+            vector<bool> is_unconnected(top.slots.size(), false);
+            for (uint32_t slot : plugs[TOP].unconnected)
+                is_unconnected[slot] = true;
+
+            vector<uint32_t> top_nodes; /**< Unconnected nodes of the top level, which keep their numbers. */
+            uint64_t next_node = 1;
+            for (const auto &slot : top.slots) {
+                next_node = max<uint64_t>(next_node, slot.first + 1);
+                if (is_unconnected[slot.second])
+                    top_nodes.push_back(slot.first);
+            }
+            sort(top_nodes.begin(), top_nodes.end());
+
+            string buffer;
+            bool any = false;
+            auto append = [&](uint64_t node) {
+                buffer += (any ? ", " : "Warning, unconnected node(s): ");
+                buffer += to_string(node);
+                any = true;
+                if (buffer.size() > (1u << 20)) {
+                    output.write(buffer.data(), static_cast<streamsize>(buffer.size()));
+                    buffer.clear();
+                }
+            };
+
+            if (plugs[TOP].ground.cnt < 2)
+                append(0);
+            for (uint32_t node : top_nodes)
+                append(node);
+
+            /** Visited instance: its block and number of the first internal node of its next instance. */
+            struct visit {
+                uint32_t block;
+                uint64_t next_node;
+                size_t next_instance;
+            };
+            vector<visit> stack = {{TOP, next_node, 0}};
+            while (!stack.empty()) {
+                visit &parent = stack.back();
+                const vector<instance> &instances = blocks[parent.block].instances;
+                if (parent.next_instance == instances.size()) {
+                    stack.pop_back();
+                    continue;
+                }
+
+                const instance &used = instances[parent.next_instance++];
+                const block_plugs &child = plugs[used.block];
+                uint64_t first_node = parent.next_node;
+                parent.next_node += child.cnt_internal;
+                if (child.cnt_unconnected == 0)
+                    continue;
+
+                size_t cnt_ports = blocks[used.block].ports.size();
+                for (uint32_t slot : child.unconnected)
+                    append(first_node + slot - cnt_ports);
+                stack.push_back({used.block, first_node + blocks[used.block].slots.size() - cnt_ports, 0});
+            }
+
+            if (any)
+                buffer += '\n';
+            output.write(buffer.data(), static_cast<streamsize>(buffer.size()));
+        }
+
+        /**
+        * @brief Returns numbers of distinct types and distinct nodes of the flattened design, counted
+        * like in stats of a flat circuit (only nodes with an element plugged in), without expanding it.
+        *
+        * @throws runtime_error if a number does not fit in 64 bits.
+        */
+        pair<uint64_t, uint64_t> count_distinct() {
+            const unordered_map<uint64_t, uint64_t> &totals = count_elements();
+            vector<bool> used_types(types.size(), false);
+            for (const auto &entry : totals)
+                used_types[static_cast<uint32_t>(entry.first)] = true;
+            return {static_cast<uint64_t>(count(used_types.begin(), used_types.end(), true)), count_nodes()};
+        }
+
+        /**
+        * @brief Writes the flattened design as a flat netlist, expanding instances lazily, one by one,
+        * depth first with an explicit stack, so deep nesting does not grow the call stack. Elements are
+        * renumbered consecutively within every label, in order of expansion, and internal nodes of instances
+        * get numbers above all nodes of the top level, so the output can be read by obwody again.
+        *
+        * @throws runtime_error if numbers of elements or nodes exceed the allowed range.
+        */
+        void flatten(ostream &output) const {
+            uint32_t next_node = 1;
+            for (const auto &slot : blocks[TOP].slots)
+                next_node = max(next_node, slot.first + 1);
+
+            uint32_t next_number[CNT_LABELS];
+            fill(begin(next_number), end(next_number), 1);
+            string buffer;
+            vector<expansion> stack;
+            stack.push_back(start_expansion(TOP, {}, next_node, next_number, buffer, output));
+            while (!stack.empty()) {
+                expansion &parent = stack.back();
+                const vector<instance> &instances = blocks[parent.block].instances;
+                if (parent.next_instance == instances.size()) {
+                    stack.pop_back();
+                    continue;
+                }
+
+                const instance &used = instances[parent.next_instance++];
+                vector<uint32_t> child_ports(used.nodes.size());
+                for (size_t i = 0; i < used.nodes.size(); i++)
+                    child_ports[i] = map_node(parent, used.nodes[i]);
+                stack.push_back(start_expansion(used.block, move(child_ports), next_node, next_number, buffer, output));
+            }
+            output.write(buffer.data(), static_cast<streamsize>(buffer.size()));
+            output.flush();
+        }
+    };
+
+    /**
+    * @brief Reads hierarchical circuit and prints quantities of its elements, in order of the list
+    * of elements but with a number instead of tags on every line, followed by the warning about
+    * unconnected nodes of the flattened circuit, or, if requested, the flattened circuit itself.
+    *
+    * @return Numbers of distinct types and distinct nodes of the flattened circuit, if stats are collected.
+    */
+    pair<uint64_t, uint64_t> run(istream &input, bool flatten) {
+        design read_design;
+        read_design.read(input);
+
+        if (flatten) {
+            read_design.flatten(cout);
+        } else {
+            string buffer = read_design.format_quantities();
+            cout.write(buffer.data(), static_cast<streamsize>(buffer.size()));
+            cout.flush();
+            stats::phase_timer timer(stats::warnings_emission);
+            read_design.list_warnings(cerr);
+        }
+        return stats::collected().enabled ? read_design.count_distinct() : pair<uint64_t, uint64_t>(0, 0);
+    }
+} // End of namespace hierarchy.
+
+namespace external {
+    using namespace circuit_structures;
+
+    constexpr size_t OUTPUT_CHUNK = 1 << 16; /**< Outputs are written in pieces of about this size. */
+    constexpr size_t MIN_RUN_BUFFER = 1 << 12; /**< Runs are read and written through buffers at least this big. */
+    constexpr size_t MAX_FAN_IN = 1 << 8; /**< At most this many runs are merged at once. */
+
+    /**
+    * @brief Appends number to the record in big endian order, so that records compare like numbers.
+    */
+    void append_be32(string &record, uint32_t number) {
+        for (int shift = 24; shift >= 0; shift -= 8)
+            record += static_cast<char>(number >> shift);
+    }
+
+    void append_be64(string &record, uint64_t number) {
+        append_be32(record, static_cast<uint32_t>(number >> 32));
+        append_be32(record, static_cast<uint32_t>(number));
+    }
+
+    uint32_t read_be32(const char *bytes) {
+        uint32_t number = 0;
+        for (int i = 0; i < 4; i++)
+            number = (number << 8) | static_cast<unsigned char>(bytes[i]);
+        return number;
+    }
+
+    uint64_t read_be64(const char *bytes) {
+        return (uint64_t{read_be32(bytes)} << 32) | read_be32(bytes + 4);
+    }
+
+    /**
+    * Anonymous temporary file in $TMPDIR (or /tmp), removed from the file system right after creation.
+    * It is not buffered: writers and readers keep their own buffers of bounded size.
+    */
+    class temporary_file {
+    private:
+        int fd;
+        uint64_t length = 0;
+
+    public:
+        /**
+        * @throws runtime_error if the file cannot be created.
+        */
+        temporary_file() {
+            const char *directory = getenv("TMPDIR");
+            string path = string(directory != nullptr && *directory != '\0' ? directory : "/tmp") + "/obwodyXXXXXX";
+            fd = mkstemp(&path[0]);
+            if (fd < 0)
+                throw runtime_error("Cannot create temporary file in " + path + ": " + strerror(errno));
+            unlink(path.c_str());
+        }
+
+        temporary_file(const temporary_file &) = delete;
+        temporary_file &operator=(const temporary_file &) = delete;
+
+        ~temporary_file() {
+            close(fd);
+        }
+
+        uint64_t size() const {
+            return length;
+        }
+
+        /**
+        * @brief Appends the data at the end of the file.
+        *
+        * @throws runtime_error if the data cannot be written.
+        */
+        void write(const void *data, size_t size) {
+            const char *bytes = static_cast<const char *>(data);
+            while (size > 0) {
+                ssize_t written = pwrite(fd, bytes, size, static_cast<off_t>(length));
+                if (written < 0) {
+                    if (errno == EINTR)
+                        continue;
+                    throw runtime_error(string("Cannot write temporary file: ") + strerror(errno));
+                }
+                bytes += written;
+                size -= static_cast<size_t>(written);
+                length += static_cast<uint64_t>(written);
+            }
+        }
+
+        /**
+        * @brief Reads given number of bytes from given offset.
+        *
+        * @throws runtime_error if the data cannot be read.
+        */
+        void read_at(void *data, size_t size, uint64_t offset) {
+            char *bytes = static_cast<char *>(data);
+            while (size > 0) {
+                ssize_t done = pread(fd, bytes, size, static_cast<off_t>(offset));
+                if (done <= 0) {
+                    if (done < 0 && errno == EINTR)
+                        continue;
+                    throw runtime_error(string("Cannot read temporary file: ") + (done < 0 ? strerror(errno)
+                                                                                         : "file is truncated"));
+                }
+                bytes += done;
+                size -= static_cast<size_t>(done);
+                offset += static_cast<uint64_t>(done);
+            }
+        }
+
+        /**
+        * @brief Gives space of bytes from begin to end, which are not read anymore, back to the file system.
+        * Offsets of the rest of the file do not change. Where holes cannot be punched, nothing is given back.
+        */
+        void release(uint64_t begin, uint64_t end) {
+#ifdef FALLOC_FL_PUNCH_HOLE
+            if (begin < end)
+                fallocate(fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, static_cast<off_t>(begin),
+                          static_cast<off_t>(end - begin));
+#else
+            (void) begin;
+            (void) end;
+#endif
+        }
+    };
+
+    /**
+    * Sorted run of records in a temporary file: each record is its size (4 bytes, native order) and bytes.
+    */
+    struct run {
+        temporary_file *file;
+        uint64_t begin;
+        uint64_t end;
+
+        void release() const {
+            file->release(begin, end);
+        }
+    };
+
+    /**
+    * Reads records of a run sequentially through a buffer of given capacity.
+    */
+    class run_reader {
+    private:
+        run source;
+        size_t capacity;
+        string buffer;
+        size_t position = 0;
+
+        void read_bytes(char *data, size_t size) {
+            while (size > 0) {
+                if (position == buffer.size()) {
+                    if (source.begin == source.end)
+                        throw runtime_error("Temporary file is truncated");
+                    buffer.resize(static_cast<size_t>(min<uint64_t>(capacity, source.end - source.begin)));
+                    source.file->read_at(&buffer[0], buffer.size(), source.begin);
+                    source.begin += buffer.size();
+                    position = 0;
+                }
+                size_t length = min(size, buffer.size() - position);
+                memcpy(data, buffer.data() + position, length);
+                position += length;
+                data += length;
+                size -= length;
+            }
+        }
+
+    public:
+        run_reader(run source, size_t capacity) : source(source), capacity(capacity) {}
+
+        /**
+        * @brief Reads the next record, returns false at the end of the run.
+        *
+        * @throws runtime_error if the run cannot be read.
+        */
+        bool next(string &record) {
+            if (position == buffer.size() && source.begin == source.end)
+                return false;
+            uint32_t size;
+            read_bytes(reinterpret_cast<char *>(&size), sizeof(size));
+            record.resize(size);
+            read_bytes(&record[0], size);
+            return true;
+        }
+    };
+
+    /**
+    * Writes records of a run at the end of a temporary file through a buffer of given capacity.
+    */
+    class run_writer {
+    private:
+        temporary_file &file;
+        size_t capacity;
+        uint64_t begin;
+        string buffer;
+
+    public:
+        run_writer(temporary_file &file, size_t capacity) : file(file), capacity(capacity), begin(file.size()) {}
+
+        void write(const string &record) {
+            auto size = static_cast<uint32_t>(record.size());
+            buffer.append(reinterpret_cast<const char *>(&size), sizeof(size));
+            buffer += record;
+            if (buffer.size() >= capacity)
+                flush();
+        }
+
+        void flush() {
+            file.write(buffer.data(), buffer.size());
+            buffer.clear();
+        }
+
+        /**
+        * @brief Writes what is left in the buffer and returns the written run.
+        */
+        run finish() {
+            flush();
+            string().swap(buffer);
+            return {&file, begin, file.size()};
+        }
+    };
+
+    /**
+    * Sorts byte strings, compared lexicographically, using a bounded amount of memory. Records are
+    * buffered until they (with the capacity of the buffer) take the memory budget, then sorted and spilled
+    * as a run. All runs are appended to one temporary file and kept in levels: as soon as a level gets
+    * fan-in runs, they are merged into one run of the next level and their space is released, so at most
+    * fan-in runs per level are ever kept and no more than fan-in runs are merged at once. Readers and
+    * the writer of a merge share the budget, so the fan-in is as big as buffers of MIN_RUN_BUFFER allow.
+    * Keys of records are encoded so that byte order is their order.
+    */
+    class external_sorter {
+    private:
+        size_t budget;
+        size_t fan_in;
+        size_t used = 0; /**< Memory taken by buffered records, without the array of records. */
+        vector<string> records;
+        unique_ptr<temporary_file> file; /**< Created with the first spilled run. */
+        vector<vector<run>> levels;
+
+        /**
+        * @brief Returns memory taken by buffered records if given record is pushed too, counting that
+        * a growing array of records is reallocated and both the old and new one exist for a while.
+        */
+        size_t memory_with(const string &record) const {
+            size_t capacity = records.capacity();
+            if (records.size() == capacity)
+                capacity += max<size_t>(2 * capacity, 1);
+            return used + record.capacity() + 1 + capacity * sizeof(string);
+        }
+
+        /**
+        * @brief Merges runs (at most fan-in of them) into a run appended to the level.
+        */
+        void merge_runs(const vector<run> &sources, size_t target_level) {
+            if (levels.size() <= target_level)
+                levels.resize(target_level + 1);
+
+            run_writer writer(*file, max(budget / (sources.size() + 1), MIN_RUN_BUFFER));
+            merge_into(sources, [&writer](const string &record) { writer.write(record); });
+            levels[target_level].push_back(writer.finish());
+            for (const run &source : sources)
+                source.release();
+        }
+
+        template<typename Visitor>
+        void merge_into(const vector<run> &sources, Visitor visit) {
+            size_t capacity = max(budget / (sources.size() + 1), MIN_RUN_BUFFER);
+            vector<run_reader> readers;
+            vector<string> heads(sources.size());
+            for (const run &source : sources)
+                readers.emplace_back(source, capacity);
+
+            auto later = [&heads](size_t a, size_t b) { return heads[a] > heads[b]; };
+            priority_queue<size_t, vector<size_t>, decltype(later)> queue(later);
+            for (size_t i = 0; i < readers.size(); i++)
+                if (readers[i].next(heads[i]))
+                    queue.push(i);
+
+            while (!queue.empty()) {
+                size_t i = queue.top();
+                queue.pop();
+                visit(heads[i]);
+                if (readers[i].next(heads[i]))
+                    queue.push(i);
+            }
+        }
+
+        /**
+        * @brief Adds the run to the level, merging full levels into the next ones.
+        */
+        void add_run(size_t level_index) {
+            while (levels[level_index].size() >= fan_in) {
+                vector<run> full = move(levels[level_index]);
+                levels[level_index].clear();
+                merge_runs(full, level_index + 1);
+                level_index++;
+            }
+        }
+
+        void spill() {
+            sort(records.begin(), records.end());
+            if (file == nullptr)
+                file = make_unique<temporary_file>();
+            if (levels.empty())
+                levels.resize(1);
+
+            run_writer writer(*file, MIN_RUN_BUFFER);
+            for (const string &record : records)
+                writer.write(record);
+            vector<string>().swap(records);
+            used = 0;
+            levels[0].push_back(writer.finish());
+            add_run(0);
+        }
+
+    public:
+        explicit external_sorter(size_t budget)
+                : budget(budget), fan_in(clamp<size_t>(budget / MIN_RUN_BUFFER, 3, MAX_FAN_IN + 1) - 1) {}
+
+        /**
+        * @throws runtime_error if a run cannot be spilled.
+        */
+        void push(string record) {
+            if (!records.empty() && memory_with(record) > budget)
+                spill();
+            used += record.capacity() + 1;
+            records.push_back(move(record));
+        }
+
+        /**
+        * @brief Visits all records in order. Records which fitted into memory are not spilled at all.
+        *
+        * @throws runtime_error if runs cannot be read or written.
+        */
+        template<typename Visitor>
+        void merge(Visitor visit) {
+            if (levels.empty()) {
+                sort(records.begin(), records.end());
+                for (const string &record : records)
+                    visit(record);
+                vector<string>().swap(records);
+                return;
+            }
+            if (!records.empty())
+                spill();
+
+            // Merges lowest levels together until the rest of runs can be merged at once.
+            auto count_runs = [this]() {
+                size_t cnt_runs = 0;
+                for (const vector<run> &runs : levels)
+                    cnt_runs += runs.size();
+                return cnt_runs;
+            };
+            while (count_runs() > fan_in) {
+                vector<run> lowest;
+                size_t last = 0;
+                for (; last < levels.size() && lowest.size() + levels[last].size() <= fan_in; last++)
+                    lowest.insert(lowest.end(), levels[last].begin(), levels[last].end());
+                for (size_t i = 0; i < last; i++)
+                    levels[i].clear();
+                merge_runs(lowest, last);
+                add_run(last);
+            }
+
+            vector<run> all;
+            for (const vector<run> &runs : levels)
+                all.insert(all.end(), runs.begin(), runs.end());
+            merge_into(all, visit);
+            levels.clear();
+            file.reset();
+        }
+    };
+
+    /**
+    * Output written in chunks, so that long lines (like the warning) are never kept whole in memory.
+    */
+    class chunked_output {
+    private:
+        ostream &output;
+        string buffer;
+
+    public:
+        explicit chunked_output(ostream &output) : output(output) {}
+
+        chunked_output(const chunked_output &) = delete;
+        chunked_output &operator=(const chunked_output &) = delete;
+
+        ~chunked_output() {
+            flush();
+        }
+
+        string &text() {
+            if (buffer.size() >= OUTPUT_CHUNK)
+                flush();
+            return buffer;
+        }
+
+        void flush() {
+            output.write(buffer.data(), static_cast<streamsize>(buffer.size()));
+            output.flush();
+            buffer.clear();
+        }
+    };
+
+    /**
+    * @brief Reads circuit from the file and lists it just like reader::read_data() with writer do,
+    * with memory use bounded by the budget instead of the size of the circuit (except for single lines
+    * of the input, which are read whole).
+    * Element lines are spilled to sorted runs keyed by (label, number, line) and merged: the first correct
+    * line of every tag is accepted, later ones are duplicates. Accepted elements are sorted again by
+    * (label, type, number) to form lines of the list, which are then ordered by their smallest numbers,
+    * and their nodes are sorted to count terminals. Numbers of incorrect lines are sorted too and their
+    * text is taken from a second pass over the file.
+    *
+    * When stats are collected, accepted types are sorted too, to count the distinct ones.
+    *
+    * @throws runtime_error if the file or temporary files cannot be read or written.
+    * @param[in] path - file with the circuit, read twice.
+    * @param[in] budget - memory budget in bytes, split between the sorters.
+    * @return Numbers of distinct types and distinct nodes of the circuit.
+    */
+    pair<size_t, size_t> run(const string &path, size_t budget) {
+        ifstream input(path);
+        if (!input)
+            throw runtime_error("Cannot open file " + path);
+
+        // At most five sorters take memory at once: elements are merged into errors, items, nodes and types.
+        size_t share = budget / 5;
+        external_sorter elements(share), errors(share);
+        reader::line_batch batch;
+        uint32_t cnt_line = 0;
+        while (batch.read(input)) {
+            stats::phase_timer timer(stats::validation);
+            for (size_t i = 0; i < batch.size(); i++) {
+                const string &line = batch[i];
+                cnt_line++;
+                scanner::element_tokens tokens;
+                scanner::line_kind kind = scanner::scan_line(line, tokens);
+                if (kind == scanner::line_kind::empty)
+                    continue;
+
+                if (kind == scanner::line_kind::malformed) {
+                    stats::count_rejection(stats::bad_syntax);
+                    string record;
+                    append_be32(record, cnt_line);
+                    errors.push(move(record));
+                    continue;
+                }
+
+                // (label's rank, number, line), distinct nodes, type
+                int distinct[MAX_TERMINALS];
+                int cnt_distinct = scanner::distinct_nodes(tokens, distinct);
+                string record(1, static_cast<char>(label_rank(tokens.tag[0])));
+                append_be32(record, static_cast<uint32_t>(tokens.tag_number));
+                append_be32(record, cnt_line);
+                record += static_cast<char>(cnt_distinct);
+                for (int j = 0; j < cnt_distinct; j++)
+                    append_be32(record, static_cast<uint32_t>(distinct[j]));
+                record += tokens.type;
+                elements.push(move(record));
+            }
+        }
+        stats::count_lines(cnt_line);
+
+        external_sorter items(share), nodes(share), types(share);
+        {
+            stats::phase_timer timer(stats::insertion);
+            string taken_tag; /**< (label's rank, number) of the last accepted element */
+            elements.merge([&](const string &record) {
+                string_view tag(record.data(), 5);
+                int cnt_distinct = record[9];
+                if (tag == taken_tag || cnt_distinct < 2) {
+                    stats::count_rejection(tag == taken_tag ? stats::duplicate_tag : stats::single_node);
+                    errors.push(record.substr(5, 4));
+                    return;
+                }
+                taken_tag = tag;
+
+                // (label's rank, type, '\0', number), types never contain '\0'
+                string item(1, record[0]);
+                item.append(record, 10 + 4 * size_t(cnt_distinct), string::npos);
+                item += '\0';
+                item.append(record, 1, 4);
+                items.push(move(item));
+                if (stats::collected().enabled)
+                    types.push(record.substr(10 + 4 * size_t(cnt_distinct)));
+                for (int i = 0; i < cnt_distinct; i++)
+                    nodes.push(record.substr(10 + 4 * size_t(i), 4));
+            });
+        }
+
+        size_t cnt_types = 0;
+        string previous_type;
+        types.merge([&](const string &type) {
+            if (cnt_types == 0 || type != previous_type)
+                cnt_types++;
+            previous_type = type;
+        });
+
+        {
+            ifstream again(path);
+            chunked_output output(cerr);
+            string text;
+            uint32_t current = 0;
+            errors.merge([&](const string &record) {
+                uint32_t target = read_be32(record.data());
+                while (current < target && getline(again, text))
+                    current++;
+                output.text() += reader::wrong_input_exception(text, static_cast<int>(target)).what();
+                output.text() += '\n';
+            });
+        }
+
+        {
+            stats::phase_timer timer(stats::items_emission);
+            temporary_file texts;
+            external_sorter lines(share);
+            uint64_t offset = 0, line_begin = 0; /**< Offsets in texts, counting the bytes still in piece. */
+            string group, piece;
+            uint32_t first_number = 0;
+
+            auto store = [&](size_t minimum) {
+                if (piece.size() >= minimum) {
+                    texts.write(piece.data(), piece.size());
+                    piece.clear();
+                }
+            };
+            auto close_line = [&]() {
+                if (group.empty())
+                    return;
+                size_t size_before = piece.size();
+                piece += ": ";
+                piece.append(group, 1, string::npos);
+                piece += '\n';
+                offset += piece.size() - size_before;
+                store(OUTPUT_CHUNK);
+
+                // (label's rank, smallest number), then position of the line in texts
+                string key(1, group[0]);
+                append_be32(key, first_number);
+                append_be64(key, line_begin);
+                append_be64(key, offset - line_begin);
+                lines.push(move(key));
+            };
+
+            items.merge([&](const string &item) {
+                size_t separator = item.size() - 5;
+                uint32_t number = read_be32(item.data() + separator + 1);
+                if (item.compare(0, separator, group) != 0) {
+                    close_line();
+                    group.assign(item, 0, separator);
+                    first_number = number;
+                    line_begin = offset;
+                } else {
+                    piece += ", ";
+                    offset += 2;
+                }
+                size_t size_before = piece.size();
+                piece += ELEMENT_KINDS[static_cast<unsigned char>(item[0])].label;
+                writer::append_number(piece, number);
+                offset += piece.size() - size_before;
+                store(OUTPUT_CHUNK);
+            });
+            close_line();
+            store(0);
+
+            chunked_output output(cout);
+            lines.merge([&](const string &key) {
+                uint64_t position = read_be64(key.data() + 5), size = read_be64(key.data() + 13);
+                for (uint64_t done = 0; done < size; ) {
+                    size_t length = static_cast<size_t>(min<uint64_t>(size - done, OUTPUT_CHUNK));
+                    string &text = output.text();
+                    size_t end = text.size();
+                    text.resize(end + length);
+                    texts.read_at(&text[end], length, position + done);
+                    done += length;
+                }
+            });
         }
 
-        if (!no_warnings)
-            cerr << endl;
+        size_t cnt_nodes = 0;
+        {
+            stats::phase_timer timer(stats::warnings_emission);
+            chunked_output output(cerr);
+            bool any = false;
+            auto warn = [&](uint32_t node) {
+                output.text() += (any ? ", " : "Warning, unconnected node(s): ");
+                writer::append_number(output.text(), node);
+                any = true;
+            };
+
+            string previous;
+            uint64_t cnt_plugs = 0;
+            auto close_node = [&]() {
+                if (!previous.empty() && cnt_plugs < 2)
+                    warn(read_be32(previous.data()));
+            };
+            nodes.merge([&](const string &node) {
+                if (previous.empty() && read_be32(node.data()) != 0)
+                    warn(0);
+                if (node != previous) {
+                    close_node();
+                    previous = node;
+                    cnt_plugs = 0;
+                    cnt_nodes++;
+                }
+                cnt_plugs++;
+            });
+            if (previous.empty())
+                warn(0);
+            close_node();
+            if (any)
+                output.text() += '\n';
+        }
+        return {cnt_types, cnt_nodes};
     }
-} // End of the namespace writer.
+} // End of namespace external.
+
+namespace batch {
+    using namespace circuit_structures;
+
+    /**
+    * State kept by a worker between netlists: the circuit and output buffers are cleared, not freed,
+    * so after the first few netlists reading next ones hardly allocates memory.
+    */
+    struct worker_state {
+        circuit data;
+        string errors; /**< Errors of the netlist followed by the warning, as printed to the standard error. */
+        string items; /**< List of elements of the netlist, followed by the connectivity report if requested. */
+        writer::items_scratch items_scratch; /**< Buffers sorting elements of the list. */
+    };
+
+    /**
+    * Indices of netlists to process, spread over per-worker deques. A worker takes netlists from the back
+    * of its own deque and, once it is empty, steals from the front of the others.
+    */
+    class work_queue {
+    private:
+        struct worker_deque {
+            mutex guard;
+            deque<size_t> jobs;
+        };
+
+        vector<worker_deque> deques;
+
+    public:
+        /**
+        * @brief Deals jobs round robin to given number of workers, in the given order.
+        */
+        work_queue(const vector<size_t> &jobs, unsigned cnt_workers) : deques(cnt_workers) {
+            for (size_t i = 0; i < jobs.size(); i++)
+                deques[i % cnt_workers].jobs.push_front(jobs[i]);
+        }
+
+        /**
+        * @brief Takes next job for the given worker.
+        *
+        * @param[in] worker - number of the worker.
+        * @param[out] job - taken job.
+        * @return False if no job is left in any deque.
+        */
+        bool take(unsigned worker, size_t &job) {
+            for (size_t i = 0; i < deques.size(); i++) {
+                worker_deque &victim = deques[(worker + i) % deques.size()];
+                lock_guard<mutex> lock(victim.guard);
+                if (victim.jobs.empty())
+                    continue;
+
+                if (i == 0) {
+                    job = victim.jobs.back();
+                    victim.jobs.pop_back();
+                } else {
+                    job = victim.jobs.front();
+                    victim.jobs.pop_front();
+                }
+                return true;
+            }
+            return false;
+        }
+    };
+
+    /**
+    * @brief Reads list of netlist files, one path per line, skipping empty lines.
+    *
+    * @throws runtime_error if the list cannot be read.
+    */
+    vector<string> read_list(const string &list_path) {
+        ifstream list_file(list_path);
+        if (!list_file)
+            throw runtime_error("Cannot open file " + list_path);
+
+        vector<string> paths;
+        string line;
+        while (getline(list_file, line))
+            if (!line.empty())
+                paths.push_back(line);
+        return paths;
+    }
+
+    /**
+    * @brief Writes buffer to the file, replacing its contents.
+    *
+    * @throws runtime_error if the file cannot be written.
+    */
+    void write_file(const string &path, const string &buffer) {
+        ofstream output(path, ios::trunc | ios::binary);
+        output.write(buffer.data(), static_cast<streamsize>(buffer.size()));
+        output.close();
+        if (!output)
+            throw runtime_error("Cannot write file " + path);
+    }
+
+    /**
+    * @brief Reads netlist into the worker's circuit and formats its outputs, just like a single run
+    * of the program with the netlist on the standard input would print them.
+    *
+    * @throws runtime_error if the netlist cannot be read.
+    * @param[in] path - path to the netlist.
+    * @param[in, out] state - state of the worker, receiving the outputs.
+    * @param[in] with_connectivity - whether to append the connectivity report to the list of elements.
+    */
+    void process_netlist(const string &path, worker_state &state, bool with_connectivity) {
+        parallel_reader::mapped_file file(path);
+        string_view contents = file.contents();
+        state.data.clear();
+        state.errors.clear();
+
+        int cnt_line = 0;
+        for (size_t begin = 0; begin < contents.size(); ) {
+            size_t end = contents.find('\n', begin);
+            if (end == string_view::npos)
+                end = contents.size();
+
+            try {
+                reader::parse_and_add_line(state.data, contents.substr(begin, end - begin), ++cnt_line);
+            } catch (reader::wrong_input_exception &e) {
+                state.errors += e.what();
+                state.errors += '\n';
+            }
+            begin = end + 1;
+        }
+
+        writer::format_all_items(state.data.view(), state.items, state.items_scratch);
+        if (with_connectivity)
+            state.items += connectivity::format_report(state.data.view());
+        state.errors += writer::format_warnings(writer::unconnected_nodes(state.data.cnt_nodes_plugs));
+    }
+
+    /**
+    * @brief Processes every netlist from the list on a pool of workers, writing list of elements
+    * of netlist FILE to FILE.bom and its errors and warning to FILE.err. Netlists are started
+    * from the largest, so that the pool is not left waiting for a big one at the end.
+    *
+    * @throws runtime_error if the list cannot be read.
+    * @param[in] list_path - file listing paths of netlists, one per line.
+    * @param[in] cnt_threads - number of workers.
+    * @param[in] with_connectivity - whether to append connectivity reports to lists of elements.
+    * @return Messages about netlists which could not be processed, in order of the list. A netlist whose
+    * processing throws anything (like bad_alloc) is reported there as well, with a fresh state of its worker,
+    * and the worker goes on with the next netlists.
+    */
+    vector<string> run(const string &list_path, unsigned cnt_threads, bool with_connectivity) {
+        vector<string> paths = read_list(list_path);
+        vector<off_t> sizes(paths.size(), 0);
+        vector<size_t> order(paths.size());
+        for (size_t i = 0; i < paths.size(); i++) {
+            struct stat file_stat;
+            if (stat(paths[i].c_str(), &file_stat) == 0)
+                sizes[i] = file_stat.st_size;
+            order[i] = i;
+        }
+        stable_sort(order.begin(), order.end(), [&sizes](size_t a, size_t b) { return sizes[a] > sizes[b]; });
 
+        auto cnt_workers = static_cast<unsigned>(min<size_t>(max(cnt_threads, 1u), max<size_t>(paths.size(), 1)));
+        work_queue queue(order, cnt_workers);
+        vector<string> failures(paths.size());
+
+        auto work = [&](unsigned worker) {
+            worker_state state;
+            size_t job;
+            while (queue.take(worker, job)) {
+                try {
+                    process_netlist(paths[job], state, with_connectivity);
+                    write_file(paths[job] + ".bom", state.items);
+                    write_file(paths[job] + ".err", state.errors);
+                } catch (runtime_error &e) {
+                    failures[job] = e.what();
+                } catch (exception &e) {
+                    failures[job] = "Cannot process file " + paths[job] + ": " + e.what();
+                    state = worker_state();
+                } catch (...) {
+                    failures[job] = "Cannot process file " + paths[job];
+                    state = worker_state();
+                }
+            }
+        };
+
+        vector<thread> workers;
+        for (unsigned i = 1; i < cnt_workers; i++)
+            workers.emplace_back(work, i);
+        work(0);
+        for (thread &worker : workers)
+            worker.join();
+
+        failures.erase(remove(failures.begin(), failures.end(), ""), failures.end());
+        return failures;
+    }
+} // End of namespace batch.
+
+
+
+namespace options {
+
+    /**
+    * Settings of a single run of the program, taken from the command line.
+    */
+    struct run_options {
+        string input_path; /**< File to read the circuit from, standard input if empty. */
+        unsigned cnt_threads = max(thread::hardware_concurrency(), 1u);
+        bool incremental = false; /**< Whether to execute edit commands from the standard input. */
+        string save_snapshot_path; /**< Where to save snapshot of the read circuit, nowhere if empty. */
+        string load_snapshot_path; /**< Snapshot to list instead of reading the circuit, none if empty. */
+        bool connectivity = false; /**< Whether to report connectivity of the circuit after listing it. */
+        bool stats = false; /**< Whether to print timing of phases and counters to the standard error. */
+        string stats_json_path; /**< Where to write timing of phases and counters as JSON, nowhere if empty. */
+        string batch_list_path; /**< File listing netlists to be processed in a batch, none if empty. */
+        string query_path; /**< File with queries to answer instead of listing the circuit, none if empty. */
+        string diff_old_path; /**< Old version of the circuit to be compared with diff_new_path, none if empty. */
+        string diff_new_path;
+        bool hierarchical = false; /**< Whether the circuit contains subcircuit definitions and instances. */
+        bool flatten = false; /**< Whether to print hierarchical circuit flattened instead of quantities. */
+        size_t memory_budget = 0; /**< Memory budget of external sorting of the circuit, in bytes, 0 if unlimited. */
+    };
+
+    constexpr size_t MIN_MEMORY_BUDGET = 1 << 16;
+
+    /**
+    * @brief Parses size in bytes, optionally followed by K, M or G (binary multiples).
+    *
+    * @throws invalid_argument if the size is incorrect or smaller than MIN_MEMORY_BUDGET.
+    */
+    size_t parse_size(const string &text) {
+        size_t end;
+        unsigned long long size = stoull(text, &end);
+        string suffix = text.substr(end);
+        if (suffix == "K" || suffix == "k")
+            size <<= 10;
+        else if (suffix == "M" || suffix == "m")
+            size <<= 20;
+        else if (suffix == "G" || suffix == "g")
+            size <<= 30;
+        else if (!suffix.empty())
+            throw invalid_argument("incorrect size " + text);
+
+        if (size < MIN_MEMORY_BUDGET)
+            throw invalid_argument("memory budget has to be at least " + to_string(MIN_MEMORY_BUDGET) + " bytes");
+        return static_cast<size_t>(size);
+    }
+
+    const char *const USAGE = "Usage: obwody [--threads N] [--incremental] [--save-snapshot SNAPSHOT] "
+                              "[--connectivity] [--query QUERIES] [--stats] [--stats-json JSON] [FILE]\n"
+                              "       obwody --load-snapshot SNAPSHOT [--connectivity] [--query QUERIES] [--stats] "
+                              "[--stats-json JSON]\n"
+                              "       obwody --batch LIST [--threads N] [--connectivity]\n"
+                              "       obwody --diff OLD NEW [--threads N]\n"
+                              "       obwody --hierarchical [--flatten] [FILE]\n"
+                              "       obwody --memory-budget SIZE [--stats] [--stats-json JSON] FILE";
+
+    /**
+    * @brief Parses command line arguments.
+    *
+    * @throws invalid_argument if arguments are incorrect.
+    * @param[in] argc - number of arguments.
+    * @param[in] argv - arguments.
+    * @return Parsed settings.
+    */
+    run_options parse_arguments(int argc, char *argv[]) {
+        run_options parsed;
+
+        for (int i = 1; i < argc; i++) {
+            string argument = argv[i];
+
+            if (argument == "--threads" && i + 1 < argc) {
+                int cnt_threads = stoi(argv[++i]);
+                if (cnt_threads < 1)
+                    throw invalid_argument("number of threads has to be positive");
+                parsed.cnt_threads = static_cast<unsigned>(cnt_threads);
+            } else if (argument == "--incremental") {
+                parsed.incremental = true;
+            } else if (argument == "--save-snapshot" && i + 1 < argc) {
+                parsed.save_snapshot_path = argv[++i];
+            } else if (argument == "--load-snapshot" && i + 1 < argc) {
+                parsed.load_snapshot_path = argv[++i];
+            } else if (argument == "--connectivity") {
+                parsed.connectivity = true;
+            } else if (argument == "--stats") {
+                parsed.stats = true;
+            } else if (argument == "--stats-json" && i + 1 < argc) {
+                parsed.stats_json_path = argv[++i];
+            } else if (argument == "--query" && i + 1 < argc) {
+                parsed.query_path = argv[++i];
+            } else if (argument == "--diff" && i + 2 < argc) {
+                parsed.diff_old_path = argv[++i];
+                parsed.diff_new_path = argv[++i];
+            } else if (argument == "--memory-budget" && i + 1 < argc) {
+                parsed.memory_budget = parse_size(argv[++i]);
+            } else if (argument == "--hierarchical") {
+                parsed.hierarchical = true;
+            } else if (argument == "--flatten") {
+                parsed.flatten = true;
+            } else if (argument == "--batch" && i + 1 < argc) {
+                parsed.batch_list_path = argv[++i];
+            } else if (argument[0] != '-' && parsed.input_path.empty()) {
+                parsed.input_path = argument;
+            } else {
+                throw invalid_argument("unexpected argument " + argument);
+            }
+        }
+
+        if (!parsed.load_snapshot_path.empty()
+            && (parsed.incremental || !parsed.input_path.empty() || !parsed.save_snapshot_path.empty()))
+            throw invalid_argument("--load-snapshot cannot be combined with other input or output");
+        if (!parsed.batch_list_path.empty()
+            && (parsed.incremental || !parsed.input_path.empty() || !parsed.save_snapshot_path.empty()
+                || !parsed.load_snapshot_path.empty() || parsed.stats || !parsed.stats_json_path.empty()))
+            throw invalid_argument("--batch can be combined only with --threads and --connectivity");
+        if (!parsed.query_path.empty() && (parsed.incremental || !parsed.batch_list_path.empty()))
+            throw invalid_argument("--query cannot be combined with --incremental or --batch");
+        if (!parsed.diff_old_path.empty()
+            && (parsed.incremental || !parsed.input_path.empty() || !parsed.save_snapshot_path.empty()
+                || !parsed.load_snapshot_path.empty() || parsed.connectivity || parsed.stats
+                || !parsed.stats_json_path.empty() || !parsed.batch_list_path.empty() || !parsed.query_path.empty()))
+            throw invalid_argument("--diff can be combined only with --threads");
+        if (parsed.flatten && !parsed.hierarchical)
+            throw invalid_argument("--flatten requires --hierarchical");
+        if (parsed.hierarchical
+            && (parsed.incremental || !parsed.save_snapshot_path.empty() || !parsed.load_snapshot_path.empty()
+                || parsed.connectivity || !parsed.batch_list_path.empty() || !parsed.query_path.empty()
+                || !parsed.diff_old_path.empty()))
+            throw invalid_argument("--hierarchical can be combined only with --flatten and --stats");
+        if (parsed.memory_budget > 0
+            && (parsed.input_path.empty() || parsed.incremental || !parsed.save_snapshot_path.empty()
+                || !parsed.load_snapshot_path.empty() || parsed.connectivity || !parsed.batch_list_path.empty()
+                || !parsed.query_path.empty() || !parsed.diff_old_path.empty() || parsed.hierarchical))
+            throw invalid_argument("--memory-budget needs FILE and can be combined only with --stats");
+        return parsed;
+    }
+} // End of namespace options.
 
 
-int main() {
-    circuit_structures::mapping_structures data;
+namespace stats {
 
-    data = reader::read_data();
-    writer::list_all_items(data);
-    writer::list_warnings(data);
+    /**
+    * @brief Prints collected stats where requested by options.
+    *
+    * @throws runtime_error if JSON file cannot be written.
+    */
+    void report(const options::run_options &run_options, size_t cnt_types, size_t cnt_nodes) {
+        if (run_options.stats)
+            cerr << format_text(cnt_types, cnt_nodes);
+
+        if (!run_options.stats_json_path.empty()) {
+            ofstream json(run_options.stats_json_path, ios::trunc);
+            json << format_json(cnt_types, cnt_nodes);
+            json.close();
+            if (!json)
+                throw runtime_error("Cannot write stats to " + run_options.stats_json_path);
+        }
+    }
+} // End of namespace stats.
+
+
+#ifndef OBWODY_NO_MAIN
+int main(int argc, char *argv[]) {
+    circuit_structures::circuit data;
+    options::run_options run_options;
+
+    try {
+        run_options = options::parse_arguments(argc, argv);
+    } catch (logic_error &e) {
+        cerr << e.what() << endl << options::USAGE << endl;
+        return 1;
+    }
+    stats::collected().enabled = run_options.stats || !run_options.stats_json_path.empty();
+
+    try {
+        if (!run_options.diff_old_path.empty()) {
+            diff::run(run_options.diff_old_path, run_options.diff_new_path, run_options.cnt_threads);
+            return 0;
+        }
+
+        if (run_options.memory_budget > 0) {
+            auto [cnt_types, cnt_nodes] = external::run(run_options.input_path, run_options.memory_budget);
+            stats::report(run_options, cnt_types, cnt_nodes);
+            return 0;
+        }
+
+        if (run_options.hierarchical) {
+            ifstream input_file;
+            if (!run_options.input_path.empty()) {
+                input_file.open(run_options.input_path);
+                if (!input_file)
+                    throw runtime_error("Cannot open file " + run_options.input_path);
+            }
+            auto [cnt_types, cnt_nodes] = hierarchy::run(run_options.input_path.empty() ? cin : input_file,
+                                                         run_options.flatten);
+            stats::report(run_options, cnt_types, cnt_nodes);
+            return 0;
+        }
+
+        if (!run_options.batch_list_path.empty()) {
+            vector<string> failures = batch::run(run_options.batch_list_path, run_options.cnt_threads,
+                                                 run_options.connectivity);
+            for (const string &failure : failures)
+                cerr << failure << endl;
+            return failures.empty() ? 0 : 1;
+        }
+
+        if (!run_options.load_snapshot_path.empty()) {
+            unique_ptr<snapshot::mapped_snapshot> loaded;
+            {
+                stats::phase_timer timer(stats::reading);
+                loaded = make_unique<snapshot::mapped_snapshot>(run_options.load_snapshot_path);
+            }
+            if (!run_options.query_path.empty()) {
+                query::run(loaded->view(), run_options.query_path);
+            } else {
+                writer::list_all_items(loaded->view(), run_options.cnt_threads);
+                writer::list_warnings(loaded->unconnected_nodes());
+            }
+            if (run_options.connectivity)
+                connectivity::list_report(loaded->view());
+            stats::report(run_options, loaded->view().cnt_types, loaded->cnt_distinct_nodes());
+            return 0;
+        }
+
+        if (!run_options.input_path.empty())
+            data = parallel_reader::read_file(run_options.input_path, run_options.cnt_threads);
+        else if (!run_options.incremental)
+            data = reader::read_data();
+
+        if (!run_options.save_snapshot_path.empty())
+            snapshot::save(data, run_options.save_snapshot_path);
+
+        if (run_options.incremental) {
+            incremental::run(data);
+        } else if (!run_options.query_path.empty()) {
+            query::run(data.view(), run_options.query_path);
+            if (run_options.connectivity)
+                connectivity::list_report(data.view());
+        } else {
+            writer::list_all_items(data, run_options.cnt_threads);
+            writer::list_warnings(data);
+            if (run_options.connectivity)
+                connectivity::list_report(data.view());
+        }
+
+        stats::report(run_options, data.types.size(), data.cnt_nodes_plugs.size());
+    } catch (runtime_error &e) {
+        cerr << e.what() << endl;
+        return 1;
+    }
 
     return 0;
-}
\ No newline at end of file
+}
+#endif
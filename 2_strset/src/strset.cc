@@ -4,9 +4,19 @@
 #include "strset.h"
 #include "strsetconst.h"
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <deque>
 #include <iostream>
-#include <map>
+#include <limits>
+#include <mutex>
 #include <set>
+#include <shared_mutex>
+#include <stdexcept>
+#include <string_view>
+#include <thread>
+#include <vector>
 
 using namespace std;
 using namespace jnp1;
@@ -21,12 +31,268 @@ namespace {
         EQUAL = 0
     };
     
-    unsigned long next_id = 0;
-    
-    using set_map = map<unsigned long, set<string>>;
+    /**
+     * Sets compare their elements with transparent std::less<>, so they can be searched for string_views
+     * without constructing strings.
+     */
+    using string_set = set<string, less<>>;
+
+    /**
+     * Mutex which does nothing, used instead of real ones when the library is not built for concurrent use.
+     */
+    struct null_mutex {
+        void lock() {}
+        bool try_lock() { return true; }
+        void unlock() {}
+        void lock_shared() {}
+        bool try_lock_shared() { return true; }
+        void unlock_shared() {}
+    };
+
+#ifdef STRSET_CONCURRENT
+    constexpr unsigned long CNT_SHARDS = 16;
+    using registry_mutex = mutex;
+    using set_mutex = shared_mutex;
+#else
+    constexpr unsigned long CNT_SHARDS = 1;
+    using registry_mutex = null_mutex;
+    using set_mutex = null_mutex;
+#endif
+
+    /**
+     * Registry of sets: dense arrays of slots, split into CNT_SHARDS shards with separate locks. Slots of
+     * a shard are kept in segments, each twice as big as the previous one, which are never moved, so that
+     * references to sets stay valid when new slots are added (strset42() may create its set in the middle
+     * of another call) and slots can be found without locking the shard. Id of a set is the global index
+     * of its slot (local index * CNT_SHARDS + shard) in the lower half of bits and the generation of the slot
+     * in the upper half. The generation is bumped whenever the set is deleted, so ids of deleted sets stay
+     * invalid after their slot gets reused. A freed slot is reused only after MIN_FREE_SLOTS other slots of its shard
+     * were freed, so generations grow slowly and ids of sets created by a program which deletes few
+     * of them remain consecutive numbers. Global indices have to fit in SLOT_BITS bits (only 16 of them
+     * where unsigned long has 32 bits), so a shard has at most SLOTS_PER_SHARD slots: when its slots run out,
+     * freed slots are reused at once, then other shards are tried, and only if no slot is left at all
+     * the registry is full. STRSET_SLOT_BITS may be defined to test that with a small registry.
+     *
+     * A shard's lock serializes adding slots and the list of its freed slots; the number of slots and
+     * pointers to segments are atomic, published after the slots are constructed, so resolving an id takes
+     * no lock of the registry. The lock of a slot guards its set, generation and liveness. Operations on
+     * existing sets thus lock only the sets they work on, while creating and deleting sets briefly lock
+     * a shard as well. The lock of a shard may be taken while holding the lock of a set, never the other
+     * way round. No set is locked while strset42() is called, as creating the 42 Set locks it.
+     */
+#ifdef STRSET_SLOT_BITS
+    constexpr int SLOT_BITS = STRSET_SLOT_BITS;
+#else
+    constexpr int SLOT_BITS = numeric_limits<unsigned long>::digits / 2;
+#endif
+    constexpr unsigned long SLOT_MASK = (1ul << SLOT_BITS) - 1;
+    constexpr unsigned long SLOTS_PER_SHARD = (SLOT_MASK + 1) / CNT_SHARDS;
+    constexpr unsigned long MAX_GENERATION = numeric_limits<unsigned long>::max() >> SLOT_BITS;
+    constexpr size_t MIN_FREE_SLOTS = 1024;
+    constexpr int FIRST_SEGMENT_BITS = 6;
+    constexpr unsigned long FIRST_SEGMENT_SLOTS = 1ul << FIRST_SEGMENT_BITS;
+    constexpr int CNT_SEGMENTS = numeric_limits<unsigned long>::digits - FIRST_SEGMENT_BITS;
+
+    static_assert(SLOT_BITS > 0 && SLOT_BITS < numeric_limits<unsigned long>::digits && SLOTS_PER_SHARD > 0,
+                  "Ids have to hold both a slot index and a generation");
+
+    struct slot {
+        string_set elements;
+        unsigned long generation = 0;
+        bool alive = false;
+        set_mutex mutex;
+    };
+
+    struct shard {
+        registry_mutex mutex;
+        atomic<unsigned long> cnt_slots{0};
+        array<atomic<slot *>, CNT_SEGMENTS> segments{};
+        deque<unsigned long> free_slots;
+
+        ~shard() {
+            for (atomic<slot *> &segment : segments)
+                delete[] segment.load(memory_order_relaxed);
+        }
+    };
+
     auto &stored_sets() {
-        static set_map sets;
-        return sets;
+        static array<shard, CNT_SHARDS> shards;
+        return shards;
+    }
+
+    atomic<unsigned long> next_shard(0);
+
+    unsigned long make_id(unsigned long slot_index, unsigned long generation) {
+        return (generation << SLOT_BITS) | slot_index;
+    }
+
+    unsigned long slot_index_of(unsigned long id) {
+        return id & SLOT_MASK;
+    }
+
+    bool is_alive(const slot &found, unsigned long id) {
+        return found.alive && found.generation == (id >> SLOT_BITS);
+    }
+
+    /**
+     * @brief Returns the number of the segment holding the slot of given local index: segment k holds
+     * FIRST_SEGMENT_SLOTS << k slots, the first of them of index FIRST_SEGMENT_SLOTS * (2^k - 1).
+     */
+    int segment_of(unsigned long local_index) {
+        return numeric_limits<unsigned long>::digits - 1 - __builtin_clzl((local_index >> FIRST_SEGMENT_BITS) + 1);
+    }
+
+    /**
+     * @brief Returns the slot of given local index, which has to be less than the number of slots of the shard.
+     */
+    slot &slot_at(const shard &registry, unsigned long local_index) {
+        int segment = segment_of(local_index);
+        slot *first = registry.segments[segment].load(memory_order_acquire);
+        return first[local_index + FIRST_SEGMENT_SLOTS - (FIRST_SEGMENT_SLOTS << segment)];
+    }
+
+    /**
+     * @brief Takes a slot of the shard: a freed one if enough of them are waiting or the shard has no room
+     * for new slots, otherwise a new one.
+     * @param registry[in, out] - the shard, locked for writing.
+     * @return - local index of the slot or SLOTS_PER_SHARD if the shard has no slot left.
+     */
+    unsigned long take_slot(shard &registry) {
+        unsigned long cnt_slots = registry.cnt_slots.load(memory_order_relaxed);
+        bool is_full = cnt_slots == SLOTS_PER_SHARD;
+        if (registry.free_slots.size() > MIN_FREE_SLOTS || (is_full && !registry.free_slots.empty())) {
+            unsigned long local_index = registry.free_slots.front();
+            registry.free_slots.pop_front();
+            return local_index;
+        }
+        if (is_full)
+            return SLOTS_PER_SHARD;
+
+        int segment = segment_of(cnt_slots);
+        if (registry.segments[segment].load(memory_order_relaxed) == nullptr)
+            registry.segments[segment].store(new slot[FIRST_SEGMENT_SLOTS << segment], memory_order_release);
+        registry.cnt_slots.store(cnt_slots + 1, memory_order_release);
+        return cnt_slots;
+    }
+
+    /**
+     * @brief Allocates a slot for a new set and returns id of the set.
+     * Shards are tried in turn, starting with the next one, so that sets are spread evenly among them.
+     * @throws length_error if every slot an id can refer to is taken.
+     */
+    unsigned long allocate_set() {
+        unsigned long first_shard = next_shard.fetch_add(1, memory_order_relaxed);
+
+        for (unsigned long k = 0; k < CNT_SHARDS; k++) {
+            unsigned long shard_index = (first_shard + k) % CNT_SHARDS;
+            shard &registry = stored_sets()[shard_index];
+            unique_lock<registry_mutex> registry_lock(registry.mutex);
+
+            unsigned long local_index = take_slot(registry);
+            if (local_index == SLOTS_PER_SHARD)
+                continue;
+
+            slot &allocated = slot_at(registry, local_index);
+            registry_lock.unlock();
+
+            unique_lock<set_mutex> set_lock(allocated.mutex);
+            allocated.alive = true;
+            return make_id(local_index * CNT_SHARDS + shard_index, allocated.generation);
+        }
+
+        throw length_error("strset: too many sets, there are no ids left");
+    }
+
+    /**
+     * @brief Returns the slot which a set of given id would occupy, without locking its shard.
+     * @param id[in] - id of the set.
+     * @return - pointer to the slot or nullptr if there is no such slot.
+     */
+    slot *find_slot(unsigned long id) {
+        const shard &registry = stored_sets()[slot_index_of(id) % CNT_SHARDS];
+        unsigned long local_index = slot_index_of(id) / CNT_SHARDS;
+
+        if (local_index >= registry.cnt_slots.load(memory_order_acquire))
+            return nullptr;
+        return &slot_at(registry, local_index);
+    }
+
+    /**
+     * @brief Frees the set of given id, which has to exist and be locked for writing.
+     * A slot whose generation would overflow is retired instead of being reused.
+     * @param id[in] - id of the set.
+     * @param freed[in] - slot of the set.
+     */
+    void free_set(unsigned long id, slot &freed) {
+        shard &registry = stored_sets()[slot_index_of(id) % CNT_SHARDS];
+
+        freed.elements = string_set();
+        freed.alive = false;
+        if (freed.generation < MAX_GENERATION) {
+            freed.generation++;
+            unique_lock<registry_mutex> registry_lock(registry.mutex);
+            registry.free_slots.push_back(slot_index_of(id) / CNT_SHARDS);
+        }
+    }
+
+    /**
+     * @brief Returns the slot of the set of given id, locked with Lock: shared_lock for reading,
+     * unique_lock for writing.
+     * @param id[in] - id of the set.
+     * @return - pointer to the slot, nullptr if the set does not exist, and the lock, which owns nothing then.
+     */
+    template<template<typename> class Lock>
+    pair<slot *, Lock<set_mutex>> get_set(unsigned long id) {
+        slot *found = find_slot(id);
+        if (found == nullptr)
+            return {nullptr, Lock<set_mutex>()};
+
+        Lock<set_mutex> lock(found->mutex);
+        if (!is_alive(*found, id))
+            return {nullptr, Lock<set_mutex>()};
+        return {found, move(lock)};
+    }
+
+    struct two_sets {
+        const string_set *first = nullptr;
+        const string_set *second = nullptr;
+        shared_lock<set_mutex> first_lock;
+        shared_lock<set_mutex> second_lock;
+    };
+
+    /**
+     * @brief Returns sets of two given ids, both locked for reading, nullptr for sets which do not exist.
+     * Locks are taken with std::lock, so concurrent calls for the same sets in opposite order do not deadlock,
+     * and a slot is locked once even if both ids refer to it.
+     * @param id1[in] - id of the first set,
+     * @param id2[in] - id of the second set.
+     */
+    two_sets get_two_sets(unsigned long id1, unsigned long id2) {
+        two_sets found;
+        slot *first_slot = find_slot(id1);
+        slot *second_slot = find_slot(id2);
+
+        if (first_slot != nullptr)
+            found.first_lock = shared_lock<set_mutex>(first_slot->mutex, defer_lock);
+        if (second_slot != nullptr && second_slot != first_slot)
+            found.second_lock = shared_lock<set_mutex>(second_slot->mutex, defer_lock);
+
+        if (found.first_lock.mutex() != nullptr && found.second_lock.mutex() != nullptr)
+            lock(found.first_lock, found.second_lock);
+        else if (found.first_lock.mutex() != nullptr)
+            found.first_lock.lock();
+        else if (found.second_lock.mutex() != nullptr)
+            found.second_lock.lock();
+
+        if (first_slot != nullptr && is_alive(*first_slot, id1))
+            found.first = &first_slot->elements;
+        if (second_slot != nullptr && is_alive(*second_slot, id2))
+            found.second = &second_slot->elements;
+        return found;
+    }
+
+    bool is_existing_set(const slot *set) {
+        return set != nullptr;
     }
 
     auto &err() {
@@ -41,19 +307,11 @@ namespace {
     const bool debug = true;
 #endif
 
-    auto get_iterator_to_set(unsigned long id) {
-        return stored_sets().find(id);
-    }
-
-    bool is_iterator_to_existing_set(set_map::iterator iterator) {
-        return iterator != stored_sets().end();
-    }    
-
-    auto get_iterator_to_string(const set<string> &set, const string &element) {
+    auto get_iterator_to_string(const string_set &set, string_view element) {
         return set.find(element);
     }
 
-    bool is_iterator_to_existing_string(set<string>::iterator iterator, const set<string> &set) {
+    bool is_iterator_to_existing_string(string_set::iterator iterator, const string_set &set) {
         return iterator != set.end();
     }
     
@@ -70,9 +328,9 @@ namespace {
      * @param second_set[in] - second set to compare.
      * @return - 1 if first set is bigger, -1 if second set is bigger and 0 when they are equal.
      */
-    comp_result compare_two_existing_sets(const set<string> &first_set, const set<string> &second_set) {
+    comp_result compare_two_existing_sets(const string_set &first_set, const string_set &second_set) {
 
-        pair<set<string>::iterator, set<string>::iterator> first_mismatch = mismatch(first_set.begin(), first_set.end(), second_set.begin());
+        pair<string_set::iterator, string_set::iterator> first_mismatch = mismatch(first_set.begin(), first_set.end(), second_set.begin());
 
         if (first_mismatch.first != first_set.end() && first_mismatch.second == second_set.end())
             return comp_result::FIRST_GREATER;
@@ -112,6 +370,12 @@ namespace {
             err() << function_name << ": result of comparing set " << id1 << " to set " << id2 << " is " << static_cast<int>(result) << endl;
     }
 
+    void log_common_elements(const char *function_name, unsigned long id1, unsigned long id2, size_t cnt_common) {
+        if (debug)
+            err() << function_name << ": sets " << id1 << " and " << id2 << " have " << cnt_common
+                  << " common element(s)" << endl;
+    }
+
     void log_set_deleted(const char *function_name, unsigned long id) {
         if (debug)
             err() << function_name << ": set " << id << " deleted" << endl;
@@ -137,12 +401,12 @@ namespace {
             err() << function_name << ": attempt to insert into the 42 Set" << endl;
     }
 
-    void log_element_present_in_set(const char *function_name, unsigned long id, string &element) {
+    void log_element_present_in_set(const char *function_name, unsigned long id, string_view element) {
         if (debug)
             err() << function_name << ": set " << id << ", element \"" << element << "\" was already present" << endl;
     }
 
-    void log_element_inserted(const char *function_name, unsigned long id, string &element) {
+    void log_element_inserted(const char *function_name, unsigned long id, string_view element) {
         if (debug)
             err() << function_name << ": set " << id << ", element \"" << element << "\" inserted" << endl;
     }
@@ -152,17 +416,17 @@ namespace {
             err() << function_name << ": attempt to remove from the 42 Set" << endl;
     }
 
-    void log_element_not_present_in_set(const char *function_name, unsigned long id, string &element) {
+    void log_element_not_present_in_set(const char *function_name, unsigned long id, string_view element) {
         if (debug)
             err() << function_name << ": set " << id << " does not contain the element \"" << element << "\"" << endl;
     }
 
-    void log_element_removed_from_set(const char *function_name, unsigned long id, string &element) {
+    void log_element_removed_from_set(const char *function_name, unsigned long id, string_view element) {
         if (debug)
             err() << function_name << ": set " << id << ", element \""<< element << "\"" << " removed" << endl;
     }
 
-    void log_test_result(const char *function_name, unsigned long id, string &element, bool is_in_set) {
+    void log_test_result(const char *function_name, unsigned long id, string_view element, bool is_in_set) {
         if (debug) {
             if (is_in_set)
                 err() << function_name << ": set " << id << " contains the element \"" << element << "\"" << endl;
@@ -181,6 +445,480 @@ namespace {
         if (debug)
             err() << function_name << ": set " << id << " cleared" << endl;
     }
+
+    void log_call_with_batch(const char *function_name, unsigned long id, size_t count) {
+        if (debug)
+            err() << function_name << "(" << id << ", " << count << " value(s))" << endl;
+    }
+
+    void log_call_with_value(const char *function_name, unsigned long id, const char *value, size_t length) {
+        if (debug) {
+            err() << function_name << "(" << id << ", ";
+            if (value == nullptr)
+                err() << "NULL";
+            else
+                err() << "\"" << string_view(value, length) << "\"";
+            err() << ", " << length << ")" << endl;
+        }
+    }
+
+    void log_call_with_value(const char *function_name, unsigned long id, const char *value, const char *suffix = "") {
+        if (debug) {
+            err() << function_name << "(" << id << ", ";
+            if (value == nullptr)
+                err() << "NULL";
+            else
+                err() << "\"" << value << "\"";
+            err() << suffix << ")" << endl;
+        }
+    }
+
+    /*************************************** ELEMENTS *****************************************************************/
+
+    void insert_element(const char *function_name, unsigned long id, string_view element) {
+        unsigned long id42 = strset42();
+        auto [found_slot, lock] = get_set<unique_lock>(id);
+        if (!is_existing_set(found_slot)) {
+            log_set_does_not_exist(function_name, id);
+            return;
+        }
+
+        if (id == id42 && !found_slot->elements.empty()) {
+            log_attempt_to_insert_to_set42(function_name);
+            return;
+        }
+
+        auto &our_set = found_slot->elements;
+        auto iterator_to_string = our_set.lower_bound(element);
+
+        if (is_iterator_to_existing_string(iterator_to_string, our_set) && *iterator_to_string == element) {
+            log_element_present_in_set(function_name, id, element);
+        }
+        else {
+            our_set.emplace_hint(iterator_to_string, element);
+            log_element_inserted(function_name, id, element);
+        }
+    }
+
+    void remove_element(const char *function_name, unsigned long id, string_view element) {
+        unsigned long id42 = strset42();
+        auto [found_slot, lock] = get_set<unique_lock>(id);
+        if (!is_existing_set(found_slot)) {
+            log_set_does_not_exist(function_name, id);
+            return;
+        }
+
+        if (id == id42) {
+            log_attempt_to_remove_from_set42(function_name);
+            return;
+        }
+
+        auto &our_set = found_slot->elements;
+        auto iterator_to_string = get_iterator_to_string(our_set, element);
+
+        if (!is_iterator_to_existing_string(iterator_to_string, our_set)) {
+            log_element_not_present_in_set(function_name, id, element);
+        }
+        else {
+            our_set.erase(iterator_to_string);
+            log_element_removed_from_set(function_name, id, element);
+        }
+    }
+
+    bool test_element(const char *function_name, unsigned long id, string_view element) {
+        auto [found_slot, lock] = get_set<shared_lock>(id);
+        if (!is_existing_set(found_slot)) {
+            log_set_does_not_exist(function_name, id);
+            return false;
+        }
+
+        auto &our_set = found_slot->elements;
+        auto iterator_to_string = get_iterator_to_string(our_set, element);
+
+        bool is_in_set = is_iterator_to_existing_string(iterator_to_string, our_set);
+        log_test_result(function_name, id, element, is_in_set);
+        return is_in_set;
+    }
+
+    /*************************************** BATCHES ******************************************************************/
+
+    constexpr int LOCAL_SEARCH_STEPS = 8;
+
+    /**
+     * @brief Prepares a batch of values: zeroes the results and makes views of the values.
+     * Values without lengths are NUL-terminated, null values become views with no data and are logged.
+     * @param values[in] - array of count values,
+     * @param lengths[in] - array of count lengths or nullptr,
+     * @param results[out] - array of count results or nullptr,
+     * @param views[out] - views of the values.
+     * @return - false if the batch is invalid (values is NULL), true otherwise.
+     */
+    bool prepare_batch(const char *function_name, const char *const *values, const size_t *lengths, size_t count,
+                       int *results, vector<string_view> &views) {
+        if (results != nullptr)
+            fill(results, results + count, 0);
+
+        if (values == nullptr && count > 0) {
+            log_invalid_value_null(function_name);
+            return false;
+        }
+
+        views.assign(count, string_view());
+        for (size_t i = 0; i < count; i++) {
+            if (values[i] == nullptr)
+                log_invalid_value_null(function_name);
+            else
+                views[i] = (lengths == nullptr ? string_view(values[i]) : string_view(values[i], lengths[i]));
+        }
+        return true;
+    }
+
+    /**
+     * @brief Returns positions of non-null values of the batch sorted by the values, equal values in the order
+     * of the batch, so that a batch is processed as if its values came one by one.
+     */
+    vector<size_t> sorted_order(const vector<string_view> &views) {
+        vector<size_t> order;
+        for (size_t i = 0; i < views.size(); i++)
+            if (views[i].data() != nullptr)
+                order.push_back(i);
+
+        auto by_value = [&views](size_t i, size_t j) { return views[i] < views[j]; };
+        if (!is_sorted(order.begin(), order.end(), by_value))
+            stable_sort(order.begin(), order.end(), by_value);
+        return order;
+    }
+
+    /**
+     * @brief Returns the first element of the set not less than the value.
+     * All elements before position have to be less than the value. Consecutive values of a sorted batch
+     * usually lie close to each other, so a few steps forward from position are tried before a search
+     * from the root.
+     */
+    template<typename Set, typename Iterator>
+    Iterator lower_bound_from(Set &set, Iterator position, string_view value) {
+        for (int i = 0; i < LOCAL_SEARCH_STEPS; i++, ++position)
+            if (position == set.end() || value <= *position)
+                return position;
+        return set.lower_bound(value);
+    }
+
+    void set_result(int *results, size_t i, bool result) {
+        if (results != nullptr)
+            results[i] = result;
+    }
+
+    /**
+     * @brief Returns the array to which results of a batch are written: results if given, otherwise outcomes,
+     * zeroed, if they are going to be logged, and nullptr if they are not needed at all.
+     */
+    int *outcomes_of(int *results, vector<int> &outcomes, size_t count) {
+        if (results != nullptr || !debug)
+            return results;
+        outcomes.assign(count, 0);
+        return outcomes.data();
+    }
+
+    /**
+     * @brief Logs outcomes of non-null values of a batch in the order of the batch, although the values
+     * were processed in sorted order.
+     * @param log[in] - function logging a value with its outcome.
+     */
+    template<typename Log>
+    void log_in_batch_order(const vector<string_view> &views, const int *outcomes, Log log) {
+        if (debug)
+            for (size_t i = 0; i < views.size(); i++)
+                if (views[i].data() != nullptr)
+                    log(views[i], outcomes[i] != 0);
+    }
+
+    void insert_batch(const char *function_name, unsigned long id, const vector<string_view> &views, int *results) {
+        unsigned long id42 = strset42();
+        auto [found_slot, lock] = get_set<unique_lock>(id);
+        if (!is_existing_set(found_slot)) {
+            log_set_does_not_exist(function_name, id);
+            return;
+        }
+
+        if (id == id42 && !found_slot->elements.empty()) {
+            log_attempt_to_insert_to_set42(function_name);
+            return;
+        }
+
+        vector<int> logged_outcomes;
+        int *outcomes = outcomes_of(results, logged_outcomes, views.size());
+        auto &our_set = found_slot->elements;
+        auto position = our_set.begin();
+        for (size_t i : sorted_order(views)) {
+            string_view element = views[i];
+            position = lower_bound_from(our_set, position, element);
+
+            if (!is_iterator_to_existing_string(position, our_set) || *position != element) {
+                position = our_set.emplace_hint(position, element);
+                set_result(outcomes, i, true);
+            }
+        }
+
+        log_in_batch_order(views, outcomes, [function_name, id](string_view element, bool inserted) {
+            if (inserted)
+                log_element_inserted(function_name, id, element);
+            else
+                log_element_present_in_set(function_name, id, element);
+        });
+    }
+
+    void remove_batch(const char *function_name, unsigned long id, const vector<string_view> &views, int *results) {
+        unsigned long id42 = strset42();
+        auto [found_slot, lock] = get_set<unique_lock>(id);
+        if (!is_existing_set(found_slot)) {
+            log_set_does_not_exist(function_name, id);
+            return;
+        }
+
+        if (id == id42) {
+            log_attempt_to_remove_from_set42(function_name);
+            return;
+        }
+
+        vector<int> logged_outcomes;
+        int *outcomes = outcomes_of(results, logged_outcomes, views.size());
+        auto &our_set = found_slot->elements;
+        auto position = our_set.begin();
+        for (size_t i : sorted_order(views)) {
+            string_view element = views[i];
+            position = lower_bound_from(our_set, position, element);
+
+            if (is_iterator_to_existing_string(position, our_set) && *position == element) {
+                position = our_set.erase(position);
+                set_result(outcomes, i, true);
+            }
+        }
+
+        log_in_batch_order(views, outcomes, [function_name, id](string_view element, bool removed) {
+            if (removed)
+                log_element_removed_from_set(function_name, id, element);
+            else
+                log_element_not_present_in_set(function_name, id, element);
+        });
+    }
+
+    void test_batch(const char *function_name, unsigned long id, const vector<string_view> &views, int *results) {
+        auto [found_slot, lock] = get_set<shared_lock>(id);
+        if (!is_existing_set(found_slot)) {
+            log_set_does_not_exist(function_name, id);
+            return;
+        }
+
+        vector<int> logged_outcomes;
+        int *outcomes = outcomes_of(results, logged_outcomes, views.size());
+        const auto &our_set = found_slot->elements;
+        auto position = our_set.begin();
+        for (size_t i : sorted_order(views)) {
+            string_view element = views[i];
+            position = lower_bound_from(our_set, position, element);
+            set_result(outcomes, i, position != our_set.end() && *position == element);
+        }
+
+        log_in_batch_order(views, outcomes, [function_name, id](string_view element, bool is_in_set) {
+            log_test_result(function_name, id, element, is_in_set);
+        });
+    }
+
+    /**
+     * @brief Creates new set of given elements and returns its id.
+     */
+    unsigned long register_set(const char *function_name, string_set &&elements) {
+        unsigned long id = allocate_set();
+        auto [found_slot, lock] = get_set<unique_lock>(id);
+        found_slot->elements = move(elements);
+
+        log_set_created(function_name, id);
+        log_set_size(function_name, id, found_slot->elements.size());
+        return id;
+    }
+
+    /*************************************** SET ALGEBRA **************************************************************/
+
+    enum class set_operation {
+        UNION,
+        INTERSECTION,
+        DIFFERENCE
+    };
+
+#ifdef STRSET_CONCURRENT
+    constexpr size_t PARALLEL_MIN_ELEMENTS = 1 << 16;
+#endif
+
+    using element_range = pair<string_set::const_iterator, string_set::const_iterator>;
+
+    /**
+     * @brief Merges two sorted ranges of elements as the operation requires, in linear time.
+     * @param first[in] - range of the first set,
+     * @param second[in] - range of the second set,
+     * @param emit[in] - function called for every element of the result, in ascending order.
+     */
+    template<set_operation Operation, typename Emit>
+    void merge_ranges(element_range first, element_range second, Emit emit) {
+        auto [i, first_end] = first;
+        auto [j, second_end] = second;
+
+        while (i != first_end && j != second_end) {
+            int result = i->compare(*j);
+            if (result < 0) {
+                if (Operation != set_operation::INTERSECTION)
+                    emit(*i);
+                ++i;
+            }
+            else if (result > 0) {
+                if (Operation == set_operation::UNION)
+                    emit(*j);
+                ++j;
+            }
+            else {
+                if (Operation != set_operation::DIFFERENCE)
+                    emit(*i);
+                ++i;
+                ++j;
+            }
+        }
+
+        if (Operation != set_operation::INTERSECTION)
+            for (; i != first_end; ++i)
+                emit(*i);
+        if (Operation == set_operation::UNION)
+            for (; j != second_end; ++j)
+                emit(*j);
+    }
+
+    /**
+     * @brief Splits two sets into given number of pairs of ranges which can be merged independently:
+     * elements of a pair are smaller than elements of the next pairs. The first set is split into equal parts,
+     * the second one at the first elements of the parts.
+     */
+    vector<pair<element_range, element_range>> split_for_merge(const string_set &first, const string_set &second,
+                                                               size_t cnt_pieces) {
+        vector<pair<element_range, element_range>> pieces;
+        auto first_begin = first.begin();
+        auto second_begin = second.begin();
+        size_t piece_size = first.size() / cnt_pieces;
+
+        for (size_t k = 1; k < cnt_pieces && piece_size > 0; k++) {
+            auto first_end = next(first_begin, static_cast<long>(piece_size));
+            auto second_end = second.lower_bound(*first_end);
+            pieces.push_back({{first_begin, first_end}, {second_begin, second_end}});
+            first_begin = first_end;
+            second_begin = second_end;
+        }
+        pieces.push_back({{first_begin, first.end()}, {second_begin, second.end()}});
+        return pieces;
+    }
+
+    /**
+     * @brief Returns number of pieces into which merging of sets of given sizes is split: one per thread
+     * if the library is built for concurrent use and the sets are big enough, otherwise one. Threads are
+     * those of the hardware, unless STRSET_MERGE_THREADS is defined, so that splitting can be tested anywhere.
+     */
+    size_t merge_pieces(size_t cnt_elements) {
+#ifdef STRSET_CONCURRENT
+#ifdef STRSET_MERGE_THREADS
+        size_t cnt_threads = STRSET_MERGE_THREADS;
+#else
+        size_t cnt_threads = max(thread::hardware_concurrency(), 1u);
+#endif
+        return max<size_t>(min(cnt_threads, cnt_elements / PARALLEL_MIN_ELEMENTS), 1);
+#else
+        (void) cnt_elements;
+        return 1;
+#endif
+    }
+
+    /**
+     * @brief Runs the piece on a new thread for all pieces but the last, which runs on the calling thread.
+     */
+    template<typename Piece>
+    void run_pieces(size_t cnt_pieces, Piece piece) {
+#ifdef STRSET_CONCURRENT
+        vector<thread> threads;
+        for (size_t k = 0; k + 1 < cnt_pieces; k++)
+            threads.emplace_back(piece, k);
+        piece(cnt_pieces - 1);
+        for (thread &t : threads)
+            t.join();
+#else
+        for (size_t k = 0; k < cnt_pieces; k++)
+            piece(k);
+#endif
+    }
+
+    /**
+     * @brief Returns the result of the operation on two sets.
+     * If the merge is split into pieces, they are merged in parallel into arrays of pointers to elements,
+     * which are then inserted to the result in order, each at its end, so in constant time.
+     */
+    template<set_operation Operation>
+    string_set merge_sets(const string_set &first, const string_set &second) {
+        string_set result;
+        auto insert_at_end = [&result](const string &element) { result.emplace_hint(result.end(), element); };
+        size_t cnt_pieces = merge_pieces(first.size() + second.size());
+
+        if (cnt_pieces == 1) {
+            merge_ranges<Operation>({first.begin(), first.end()}, {second.begin(), second.end()}, insert_at_end);
+            return result;
+        }
+
+        auto pieces = split_for_merge(first, second, cnt_pieces);
+        vector<vector<const string *>> merged(pieces.size());
+        run_pieces(pieces.size(), [&pieces, &merged](size_t k) {
+            merge_ranges<Operation>(pieces[k].first, pieces[k].second,
+                                    [&merged, k](const string &element) { merged[k].push_back(&element); });
+        });
+
+        for (const vector<const string *> &piece : merged)
+            for (const string *element : piece)
+                insert_at_end(*element);
+        return result;
+    }
+
+    size_t count_common_elements(const string_set &first, const string_set &second) {
+        auto pieces = split_for_merge(first, second, merge_pieces(first.size() + second.size()));
+        vector<size_t> counts(pieces.size(), 0);
+
+        run_pieces(pieces.size(), [&pieces, &counts](size_t k) {
+            merge_ranges<set_operation::INTERSECTION>(pieces[k].first, pieces[k].second,
+                                                      [&counts, k](const string &) { counts[k]++; });
+        });
+
+        size_t cnt_common = 0;
+        for (size_t count : counts)
+            cnt_common += count;
+        return cnt_common;
+    }
+
+    /**
+     * @brief Creates new set, the result of the operation on sets of given ids; sets which do not exist
+     * are treated as empty.
+     * @return - id of the created set.
+     */
+    template<set_operation Operation>
+    unsigned long create_result_of(const char *function_name, unsigned long id1, unsigned long id2) {
+        if (debug)
+            err() << function_name << "(" << id1 << ", " << id2 << ")" << endl;
+
+        string_set elements;
+        {
+            two_sets found = get_two_sets(id1, id2);
+            string_set empty_set;
+            elements = merge_sets<Operation>(found.first != nullptr ? *found.first : empty_set,
+                                             found.second != nullptr ? *found.second : empty_set);
+
+            if (found.first == nullptr)
+                log_set_does_not_exist(function_name, id1);
+            if (found.second == nullptr)
+                log_set_does_not_exist(function_name, id2);
+        }
+
+        return register_set(function_name, move(elements));
+    }
 }
 
 namespace jnp1 {
@@ -189,30 +927,43 @@ namespace jnp1 {
         if(debug)
             err() << __func__ << "()" << endl;
 
-        unsigned long id = next_id;
-        next_id++;
-        stored_sets()[id] = set<string>();
+        unsigned long id = allocate_set();
 
         log_set_created(__func__, id);
 
         return id;
     }
 
+    unsigned long strset_new_from_sorted(const char *const *values, const size_t *lengths, size_t count) {
+        if (debug)
+            err() << __func__ << "(" << count << " value(s))" << endl;
+
+        string_set elements;
+        vector<string_view> views;
+        if (prepare_batch(__func__, values, lengths, count, nullptr, views))
+            for (string_view element : views)
+                if (element.data() != nullptr)
+                    elements.emplace_hint(elements.end(), element);
+
+        return register_set(__func__, move(elements));
+    }
+
     void strset_delete(unsigned long id) {
         if (debug)
             err() << __func__ << "(" << id << ")" << endl;
 
-        auto iterator_to_id = get_iterator_to_set(id);
-        if (!is_iterator_to_existing_set(iterator_to_id)) {
+        unsigned long id42 = strset42();
+        auto [found_slot, lock] = get_set<unique_lock>(id);
+        if (!is_existing_set(found_slot)) {
             log_set_does_not_exist(__func__, id);
             return;
         }
-        if (id == strset42()) {
+        if (id == id42) {
             log_attempt_to_remove_set42(__func__);
             return;
         }
 
-        stored_sets().erase(iterator_to_id);
+        free_set(id, *found_slot);
         log_set_deleted(__func__, id);
     }
 
@@ -220,125 +971,127 @@ namespace jnp1 {
         if(debug)
             err() << __func__ << "("<< id << ")" << endl;
 
-        auto iterator_to_id = get_iterator_to_set(id);
-        if (!is_iterator_to_existing_set(iterator_to_id)) {
+        auto [found_slot, lock] = get_set<shared_lock>(id);
+        if (!is_existing_set(found_slot)) {
             log_set_does_not_exist(__func__, id);
             return NONEXISTENT_SET_SIZE;
         }
 
-        size_t number_of_elements = (iterator_to_id->second).size();
+        size_t number_of_elements = found_slot->elements.size();
         log_set_size(__func__, id, number_of_elements);
         return number_of_elements;
     }
 
     void strset_insert(unsigned long id, const char *value) {
-        if(debug)
-            err() << __func__ << "("<< id << ", " << (value == nullptr ? "NULL" : ("\"" + string(value)) + "\"") << ")" << endl;
+        log_call_with_value(__func__, id, value);
 
-        auto iterator_to_id = get_iterator_to_set(id);
         if (value == nullptr) {
             log_invalid_value_null(__func__);
             return;
         }
 
-        if (!is_iterator_to_existing_set(iterator_to_id)) {
-            log_set_does_not_exist(__func__, id);
-            return;
-        }
+        insert_element(__func__, id, value);
+    }
+
+    void strset_insert_n(unsigned long id, const char *value, size_t length) {
+        log_call_with_value(__func__, id, value, length);
 
-        if (id == strset42() && !(iterator_to_id->second).empty()) {
-            log_attempt_to_insert_to_set42(__func__);
+        if (value == nullptr) {
+            log_invalid_value_null(__func__);
             return;
         }
 
-        string element(value);
-        auto &our_set = iterator_to_id->second;
-        auto iterator_to_string = get_iterator_to_string(our_set, element);
-
-        if (is_iterator_to_existing_string(iterator_to_string, our_set)) {
-            log_element_present_in_set(__func__, id, element);
-        }
-        else {
-            (iterator_to_id->second).insert(element);
-            log_element_inserted(__func__, id, element);
-        }
+        insert_element(__func__, id, string_view(value, length));
     }
 
     void strset_remove(unsigned long id, const char *value) {
-        if(debug)
-            err() << __func__ << "("<< id << ", " << (value == nullptr ? "NULL" : ("\"" + string(value)) + "\"") + "\"" << ")" << endl;
+        log_call_with_value(__func__, id, value, "\"");
 
         if (value == nullptr) {
             log_invalid_value_null(__func__);
             return;
         }
 
-        auto iterator_to_set = get_iterator_to_set(id);
-        if (!is_iterator_to_existing_set(iterator_to_set)) {
-            log_set_does_not_exist(__func__, id);
-            return;
-        }
+        remove_element(__func__, id, value);
+    }
+
+    void strset_remove_n(unsigned long id, const char *value, size_t length) {
+        log_call_with_value(__func__, id, value, length);
 
-        if (id == strset42()) {
-            log_attempt_to_remove_from_set42(__func__);
+        if (value == nullptr) {
+            log_invalid_value_null(__func__);
             return;
         }
 
-        string element(value);
-        auto &our_set = iterator_to_set->second;
-        auto iterator_to_string = get_iterator_to_string(our_set, element);
-
-        if (!is_iterator_to_existing_string(iterator_to_string, our_set)) {
-            log_element_not_present_in_set(__func__, id, element);
-        }
-        else {
-            our_set.erase(element);
-            log_element_removed_from_set(__func__, id, element);
-        }
+        remove_element(__func__, id, string_view(value, length));
     }
 
     int strset_test(unsigned long id, const char* value) {
-        if(debug)
-            err() << __func__ << "("<< id << ", " << (value == nullptr ? "NULL" : ("\"" + string(value)) + "\"") << ")" << endl;
+        log_call_with_value(__func__, id, value);
 
-        bool is_in_set = false;
-        auto iterator_to_set = get_iterator_to_set(id);
         if (value == nullptr) {
             log_invalid_value_null(__func__);
-            return is_in_set;
+            return false;
         }
 
-        if (!is_iterator_to_existing_set(iterator_to_set)) {
-            log_set_does_not_exist(__func__, id);
-            return is_in_set;
+        return test_element(__func__, id, value);
+    }
+
+    int strset_test_n(unsigned long id, const char *value, size_t length) {
+        log_call_with_value(__func__, id, value, length);
+
+        if (value == nullptr) {
+            log_invalid_value_null(__func__);
+            return false;
         }
 
-        string element(value);
-        auto &our_set = iterator_to_set->second;
-        auto iterator_to_string = get_iterator_to_string(our_set, element);
+        return test_element(__func__, id, string_view(value, length));
+    }
 
-        is_in_set = is_iterator_to_existing_string(iterator_to_string, our_set);
-        log_test_result(__func__, id, element, is_in_set);
+    void strset_insert_batch(unsigned long id, const char *const *values, const size_t *lengths, size_t count,
+                             int *results) {
+        log_call_with_batch(__func__, id, count);
 
-        return is_in_set;
+        vector<string_view> views;
+        if (prepare_batch(__func__, values, lengths, count, results, views))
+            insert_batch(__func__, id, views, results);
+    }
+
+    void strset_remove_batch(unsigned long id, const char *const *values, const size_t *lengths, size_t count,
+                             int *results) {
+        log_call_with_batch(__func__, id, count);
+
+        vector<string_view> views;
+        if (prepare_batch(__func__, values, lengths, count, results, views))
+            remove_batch(__func__, id, views, results);
+    }
+
+    void strset_test_batch(unsigned long id, const char *const *values, const size_t *lengths, size_t count,
+                           int *results) {
+        log_call_with_batch(__func__, id, count);
+
+        vector<string_view> views;
+        if (prepare_batch(__func__, values, lengths, count, results, views))
+            test_batch(__func__, id, views, results);
     }
 
     void strset_clear(unsigned long id) {
         if(debug)
             err() << __func__ << "("<< id << ")" << endl;
 
-        auto iterator_to_id = get_iterator_to_set(id);
-        if (!is_iterator_to_existing_set(iterator_to_id)) {
+        unsigned long id42 = strset42();
+        auto [found_slot, lock] = get_set<unique_lock>(id);
+        if (!is_existing_set(found_slot)) {
             log_set_does_not_exist(__func__, id);
             return;
         }
 
-        if(id == strset42()) {
+        if(id == id42) {
             log_attempt_to_clear_set42(__func__);
             return;
         }
 
-        (iterator_to_id->second).clear();
+        found_slot->elements.clear();
         log_set_cleared(__func__, id);
 
     }
@@ -348,14 +1101,13 @@ namespace jnp1 {
             err() << __func__ << "("<< id1 << ", " << id2 << ")" << endl;
         
         comp_result result;
-        auto first_iterator = get_iterator_to_set(id1);
-        auto second_iterator = get_iterator_to_set(id2);
-        bool first_exists = is_iterator_to_existing_set(first_iterator);
-        bool second_exists = is_iterator_to_existing_set(second_iterator);
-        set<string> empty_set;
+        two_sets found = get_two_sets(id1, id2);
+        bool first_exists = found.first != nullptr;
+        bool second_exists = found.second != nullptr;
+        string_set empty_set;
 
-        result = (compare_two_existing_sets(first_exists ? first_iterator->second : empty_set,
-                                            second_exists ? second_iterator->second : empty_set));
+        result = (compare_two_existing_sets(first_exists ? *found.first : empty_set,
+                                            second_exists ? *found.second : empty_set));
 
         log_compare_result(__func__, id1, id2, result);
         
@@ -367,5 +1119,35 @@ namespace jnp1 {
         
         return static_cast<int>(result);
     }
+
+    unsigned long strset_union(unsigned long id1, unsigned long id2) {
+        return create_result_of<set_operation::UNION>(__func__, id1, id2);
+    }
+
+    unsigned long strset_intersection(unsigned long id1, unsigned long id2) {
+        return create_result_of<set_operation::INTERSECTION>(__func__, id1, id2);
+    }
+
+    unsigned long strset_difference(unsigned long id1, unsigned long id2) {
+        return create_result_of<set_operation::DIFFERENCE>(__func__, id1, id2);
+    }
+
+    size_t strset_intersection_size(unsigned long id1, unsigned long id2) {
+        if (debug)
+            err() << __func__ << "(" << id1 << ", " << id2 << ")" << endl;
+
+        two_sets found = get_two_sets(id1, id2);
+        if (found.first == nullptr || found.second == nullptr) {
+            if (found.first == nullptr)
+                log_set_does_not_exist(__func__, id1);
+            if (found.second == nullptr)
+                log_set_does_not_exist(__func__, id2);
+            return NONEXISTENT_SET_SIZE;
+        }
+
+        size_t cnt_common = count_common_elements(*found.first, *found.second);
+        log_common_elements(__func__, id1, id2, cnt_common);
+        return cnt_common;
+    }
 }
 #endif
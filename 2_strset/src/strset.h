@@ -3,6 +3,17 @@
 
 #include <stdio.h>
 
+/*
+ * The library is not thread-safe by default. Built with STRSET_CONCURRENT defined, all functions below may be
+ * called concurrently from many threads. Looking a set up takes no lock of the registry, so operations on
+ * existing sets lock only the sets they work on: those on different sets do not contend and tests of the same
+ * set run in parallel. Creating and deleting a set also briefly locks one of 16 shards of the registry.
+ *
+ * Ids of sets are reused only after a generation count stored in them changes, so an id of a deleted set never
+ * refers to another set. Functions creating sets throw std::length_error, which terminates a C program, when
+ * every id is taken: 2^16 sets may exist at once where unsigned long has 32 bits, 2^32 where it has 64.
+ */
+
 #ifdef __cplusplus
 extern "C" {
     namespace jnp1 {
@@ -13,6 +24,18 @@ extern "C" {
          */
         extern unsigned long strset_new();
 
+        /**
+         * @brief Creates new set of given values and returns its id.
+         * Values sorted in ascending order, as by strcmp (memcmp for values with lengths), are inserted in linear
+         * time; unsorted values are inserted as well, only slower. Repeated values are inserted once,
+         * NULL values are skipped.
+         * @param values[in] - array of count values,
+         * @param lengths[in] - array of count lengths of the values, or NULL if the values are NUL-terminated,
+         * @param count[in] - number of values.
+         * @return - id of the created set.
+         */
+        extern unsigned long strset_new_from_sorted(const char* const* values, const size_t* lengths, size_t count);
+
         /**
          * @brief Deletes a set of given id.
          * If set of given id exist the function deletes it, otherwise it does nothing.
@@ -37,6 +60,15 @@ extern "C" {
          * @param value[in] - element that should be inserted to the set.
          */
         extern void strset_insert(unsigned long id, const char* value);
+
+        /**
+         * @brief Inserts a value of given length to the set of given id.
+         * Works as strset_insert, but the value does not have to be NUL-terminated and may contain NUL bytes.
+         * @param id[in] - id of set we want to insert to,
+         * @param value[in] - element that should be inserted to the set,
+         * @param length[in] - length of the element in bytes.
+         */
+        extern void strset_insert_n(unsigned long id, const char* value, size_t length);
         
         /**
          * @brief Removes a value from the set of given id.
@@ -46,6 +78,15 @@ extern "C" {
          * @param value[in] - element that should be removed.
          */
         extern void strset_remove(unsigned long id, const char* value);
+
+        /**
+         * @brief Removes a value of given length from the set of given id.
+         * Works as strset_remove, but the value does not have to be NUL-terminated and may contain NUL bytes.
+         * @param id[in] - id of set we want to remove from,
+         * @param value[in] - element that should be removed,
+         * @param length[in] - length of the element in bytes.
+         */
+        extern void strset_remove_n(unsigned long id, const char* value, size_t length);
         
         /**
          * @brief Checks if a value is in the set of given id.serieses
@@ -56,7 +97,59 @@ extern "C" {
          * @return - 1 if the value is in the set, 0 if not.
          */
         extern int strset_test(unsigned long id, const char* value);
+
+        /**
+         * @brief Checks if a value of given length is in the set of given id.
+         * Works as strset_test, but the value does not have to be NUL-terminated and may contain NUL bytes.
+         * @param id[in] - id of set we want to check,
+         * @param value[in] - value to be checked,
+         * @param length[in] - length of the value in bytes.
+         * @return - 1 if the value is in the set, 0 if not.
+         */
+        extern int strset_test_n(unsigned long id, const char* value, size_t length);
         
+        /**
+         * @brief Inserts a batch of values to the set of given id.
+         * Works as strset_insert called for every value in turn, but finds the set once and inserts the values
+         * in sorted order. The result of a value is 1 if it was inserted and 0 otherwise. Debug logs report
+         * NULL values first, then the outcome of every other value in the order of the batch.
+         * @param id[in] - id of set we want to insert to,
+         * @param values[in] - array of count values,
+         * @param lengths[in] - array of count lengths of the values, or NULL if the values are NUL-terminated,
+         * @param count[in] - number of values,
+         * @param results[out] - array of count results, or NULL if they are not needed.
+         */
+        extern void strset_insert_batch(unsigned long id, const char* const* values, const size_t* lengths,
+                                        size_t count, int* results);
+
+        /**
+         * @brief Removes a batch of values from the set of given id.
+         * Works as strset_remove called for every value in turn, but finds the set once and removes the values
+         * in sorted order. The result of a value is 1 if it was removed and 0 otherwise. Debug logs report
+         * NULL values first, then the outcome of every other value in the order of the batch.
+         * @param id[in] - id of set we want to remove from,
+         * @param values[in] - array of count values,
+         * @param lengths[in] - array of count lengths of the values, or NULL if the values are NUL-terminated,
+         * @param count[in] - number of values,
+         * @param results[out] - array of count results, or NULL if they are not needed.
+         */
+        extern void strset_remove_batch(unsigned long id, const char* const* values, const size_t* lengths,
+                                        size_t count, int* results);
+
+        /**
+         * @brief Checks if values of a batch are in the set of given id.
+         * Works as strset_test called for every value, but finds the set once and looks the values up
+         * in sorted order. The result of a value is what strset_test would return. Debug logs report
+         * NULL values first, then the result of every other value in the order of the batch.
+         * @param id[in] - id of set we want to check,
+         * @param values[in] - array of count values,
+         * @param lengths[in] - array of count lengths of the values, or NULL if the values are NUL-terminated,
+         * @param count[in] - number of values,
+         * @param results[out] - array of count results.
+         */
+        extern void strset_test_batch(unsigned long id, const char* const* values, const size_t* lengths,
+                                      size_t count, int* results);
+
         /**
          * @brief Deletes all elements from the set.
          * If the set of given id exists the function deletes all its elements,
@@ -79,6 +172,47 @@ extern "C" {
          * @return - 1 if first set si bigger, -1 if second set is bigger and 0 when they are equal.
          */
         extern int strset_comp(unsigned long id1, unsigned long id2);
+
+        /**
+         * @brief Creates the union of two sets.
+         * Creates new set of elements belonging to the set of id1 or to the set of id2, in time linear in sizes
+         * of both sets. If one of the sets does not exist it is treated as an empty set.
+         * @param id1[in] - id of first set,
+         * @param id2[in] - id of second set.
+         * @return - id of the created set.
+         */
+        extern unsigned long strset_union(unsigned long id1, unsigned long id2);
+
+        /**
+         * @brief Creates the intersection of two sets.
+         * Creates new set of elements belonging both to the set of id1 and to the set of id2, in time linear
+         * in sizes of both sets. If one of the sets does not exist it is treated as an empty set.
+         * @param id1[in] - id of first set,
+         * @param id2[in] - id of second set.
+         * @return - id of the created set.
+         */
+        extern unsigned long strset_intersection(unsigned long id1, unsigned long id2);
+
+        /**
+         * @brief Creates the difference of two sets.
+         * Creates new set of elements belonging to the set of id1 but not to the set of id2, in time linear
+         * in sizes of both sets. If one of the sets does not exist it is treated as an empty set.
+         * @param id1[in] - id of first set,
+         * @param id2[in] - id of second set.
+         * @return - id of the created set.
+         */
+        extern unsigned long strset_difference(unsigned long id1, unsigned long id2);
+
+        /**
+         * @brief Counts common elements of two sets.
+         * Returns the number of elements belonging both to the set of id1 and to the set of id2, counted
+         * in time linear in sizes of both sets, without creating any set. If one of the sets does not exist
+         * the function returns 0.
+         * @param id1[in] - id of first set,
+         * @param id2[in] - id of second set.
+         * @return - size of the intersection of the sets.
+         */
+        extern size_t strset_intersection_size(unsigned long id1, unsigned long id2);
 #ifdef __cplusplus
     }
 }
@@ -1,7 +1,9 @@
 #ifndef STRSETCONST
 #define STRSETCONST
 
+#include <atomic>
 #include <iostream>
+#include <mutex>
 
 #include "strset.h"
 #include "strsetconst.h"
@@ -17,8 +19,19 @@ namespace {
         return error;
     }
 
-    bool was_it_created = false;
+    /**
+     * The 42 Set is published through was_it_created only when it already contains "42", so no other
+     * thread sees it empty. Creating it calls strset_insert, which calls strset42() again from the same
+     * thread: the mutex is recursive and such a call gets the id of the set being created.
+     */
+    atomic<bool> was_it_created(false);
+    bool is_being_created = false;
     unsigned long id42;
+
+    auto &creation_mutex() {
+        static recursive_mutex mutex;
+        return mutex;
+    }
     
 #ifdef NDEBUG
     const bool debug = false;
@@ -30,16 +43,21 @@ namespace {
 namespace jnp1 {
 
     unsigned long strset42() {
-        if (!was_it_created) {
-            if (debug)
-                err() << "strsetconst init invoked" << endl;
-            
-            id42 = strset_new();
-            was_it_created = true;
-            strset_insert(id42, "42");
-            
-            if (debug)
-                err() << "strsetconst init finished" << endl;
+        if (!was_it_created.load(memory_order_acquire)) {
+            lock_guard<recursive_mutex> lock(creation_mutex());
+
+            if (!was_it_created.load(memory_order_relaxed) && !is_being_created) {
+                if (debug)
+                    err() << "strsetconst init invoked" << endl;
+
+                is_being_created = true;
+                id42 = strset_new();
+                strset_insert(id42, "42");
+                was_it_created.store(true, memory_order_release);
+
+                if (debug)
+                    err() << "strsetconst init finished" << endl;
+            }
         }
         
         return id42;
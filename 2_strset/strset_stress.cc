@@ -0,0 +1,265 @@
+/*
+  Stress test of the strset library built for concurrent use.
+
+  g++ -O1 -g -std=c++17 -DNDEBUG -DSTRSET_CONCURRENT -fsanitize=thread -Isrc \
+      strset_stress.cc src/strset.cc src/strsetconst.cc -o strset_stress -pthread
+  ./strset_stress [--threads N] [--rounds R]
+
+  All threads race for the 42 Set first, then each of them works on its own sets, inserts and removes
+  its own values in sets shared by all threads, compares the shared sets and creates and deletes sets,
+  checking that ids of deleted sets are rejected. Then a single thread deletes so many sets that their slots
+  are reused and checks that old ids stay invalid; built with STRSET_SLOT_BITS (e.g. -DSTRSET_SLOT_BITS=8,
+  to test the registry of a 32-bit unsigned long in small) it also fills the registry up. Finally throughput
+  of strset_test on sets private to each thread, which locks nothing but the set, and of creating and deleting
+  sets, which also locks a shard of the registry, is measured for 1, 2, ... N threads, with the speedup over
+  one thread. The former should grow linearly as long as there are cores.
+*/
+
+#include "strset.h"
+#include "strsetconst.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+using namespace jnp1;
+
+namespace {
+
+    constexpr int CNT_SHARED_SETS = 4;
+
+    atomic<int> cnt_failures(0);
+
+    void check(bool condition, const char *what) {
+        if (!condition) {
+            cnt_failures++;
+            cerr << "Failed: " << what << endl;
+        }
+    }
+
+    string value_of(int thread_number, int i) {
+        return to_string(thread_number) + ":" + to_string(i);
+    }
+
+    void race_for_set42(vector<unsigned long> &seen_ids, int thread_number) {
+        unsigned long id = strset42();
+        seen_ids[thread_number] = id;
+        check(strset_size(id) == 1, "the 42 Set contains one element");
+        check(strset_test(id, "42"), "the 42 Set contains \"42\"");
+        strset_insert(id, "24");
+        check(!strset_test(id, "24"), "the 42 Set cannot be inserted to");
+    }
+
+    void work(const vector<unsigned long> &shared_sets, int thread_number, int cnt_rounds) {
+        unsigned long own = strset_new();
+
+        for (int round = 0; round < cnt_rounds; round++) {
+            string value = value_of(thread_number, round);
+
+            strset_insert(own, value.c_str());
+            check(strset_test(own, value.c_str()), "value inserted to own set is present");
+
+            unsigned long shared = shared_sets[round % CNT_SHARED_SETS];
+            strset_insert(shared, value.c_str());
+            check(strset_test(shared, value.c_str()), "value inserted to shared set is present");
+            strset_comp(shared_sets[0], shared_sets[1]);
+            strset_comp(shared_sets[1], shared_sets[0]);
+            if (round % 2 == 1) {
+                strset_remove(shared, value.c_str());
+                check(!strset_test(shared, value.c_str()), "value removed from shared set is absent");
+            }
+
+            unsigned long temporary = strset_new();
+            strset_insert(temporary, value.c_str());
+            check(strset_size(temporary) == 1, "new set contains one element");
+            strset_delete(temporary);
+            strset_insert(temporary, value.c_str());
+            check(strset_size(temporary) == 0, "deleted set does not exist");
+            check(!strset_test(temporary, value.c_str()), "deleted set contains nothing");
+        }
+
+        check(strset_size(own) == static_cast<size_t>(cnt_rounds), "own set contains every value");
+        strset_delete(own);
+    }
+
+    /**
+     * @brief Creates and deletes sets one by one, so many that freed slots of every shard are reused,
+     * and checks that no id is given twice and that ids of deleted sets do not refer to any set.
+     */
+    void check_reused_ids() {
+        constexpr int CNT_SETS = 40000;
+        vector<unsigned long> deleted;
+
+        for (int i = 0; i < CNT_SETS; i++) {
+            unsigned long id = strset_new();
+            strset_insert(id, "deleted");
+            strset_delete(id);
+            deleted.push_back(id);
+        }
+        unsigned long live = strset_new();
+        strset_insert(live, "live");
+
+        sort(deleted.begin(), deleted.end());
+        check(adjacent_find(deleted.begin(), deleted.end()) == deleted.end(), "no id is given twice");
+        check(!binary_search(deleted.begin(), deleted.end(), live), "id of a deleted set is not given again");
+        for (unsigned long id : deleted) {
+            strset_insert(id, "stale");
+            check(strset_size(id) == 0, "id of a deleted set refers to no set");
+        }
+        check(strset_size(live) == 1 && !strset_test(live, "stale"), "ids of deleted sets do not change other sets");
+        strset_delete(live);
+    }
+
+#ifdef STRSET_SLOT_BITS
+    /**
+     * @brief Creates sets until the registry is full and checks that it stays consistent: a freed id
+     * is not given again, but its slot is.
+     */
+    void check_full_registry() {
+        constexpr unsigned long CNT_IDS = 1ul << STRSET_SLOT_BITS;
+        vector<unsigned long> created;
+        bool is_full = false;
+
+        while (!is_full && created.size() <= CNT_IDS) {
+            try {
+                created.push_back(strset_new());
+            }
+            catch (length_error &) {
+                is_full = true;
+            }
+        }
+        check(is_full && created.size() < CNT_IDS, "the registry gets full");
+
+        unsigned long freed = created.back();
+        strset_delete(freed);
+        created.back() = strset_new();
+        check(created.back() != freed, "id of a deleted set is not given again when the registry is full");
+        strset_insert(freed, "stale");
+        check(strset_size(freed) == 0 && strset_size(created.back()) == 0, "a stale id refers to no set");
+
+        for (unsigned long id : created)
+            strset_delete(id);
+        unsigned long id = strset_new();
+        check(strset_size(id) == 0, "deleted sets make room for new ones");
+        strset_delete(id);
+    }
+#endif
+
+    /**
+     * @brief Returns number of operations per second done by given number of threads, each of them
+     * calling work(thread_number), which returns the number of operations it did.
+     */
+    template<typename Work>
+    double throughput(int cnt_threads, Work work) {
+        vector<thread> threads;
+        atomic<long> cnt_operations(0);
+        auto start = chrono::steady_clock::now();
+
+        for (int i = 0; i < cnt_threads; i++)
+            threads.emplace_back([i, &work, &cnt_operations]() { cnt_operations += work(i); });
+        for (thread &t : threads)
+            t.join();
+
+        chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+        return cnt_operations / elapsed.count();
+    }
+
+    long test_own_set(int thread_number) {
+        constexpr int CNT_VALUES = 64;
+        constexpr int CNT_TESTS = 200000;
+        unsigned long id = strset_new();
+        vector<string> values;
+        for (int j = 0; j < CNT_VALUES; j++) {
+            values.push_back(value_of(thread_number, j));
+            strset_insert(id, values.back().c_str());
+        }
+
+        int cnt_found = 0;
+        for (int j = 0; j < CNT_TESTS; j++)
+            cnt_found += strset_test(id, values[j % CNT_VALUES].c_str());
+        check(cnt_found == CNT_TESTS, "every tested value is present");
+        strset_delete(id);
+        return CNT_TESTS;
+    }
+
+    long create_and_delete_sets(int) {
+        constexpr int CNT_SETS = 20000;
+        for (int j = 0; j < CNT_SETS; j++)
+            strset_delete(strset_new());
+        return CNT_SETS;
+    }
+
+    /**
+     * @brief Prints throughput of the work for 1, 2, 4 ... cnt_threads threads and its speedup over one thread.
+     */
+    template<typename Work>
+    void print_scaling(const char *operation, int cnt_threads, Work work) {
+        double single = 0;
+        for (int i = 1; i <= cnt_threads; i *= 2) {
+            double measured = throughput(i, work);
+            if (i == 1)
+                single = measured;
+            cout << i << " thread(s): " << static_cast<long>(measured) << " " << operation << "/s, speedup "
+                 << measured / single << endl;
+        }
+    }
+}
+
+int main(int argc, char *argv[]) {
+    int cnt_threads = static_cast<int>(max(thread::hardware_concurrency(), 4u));
+    int cnt_rounds = 2000;
+
+    for (int i = 1; i + 1 < argc; i += 2) {
+        string argument = argv[i];
+        if (argument == "--threads")
+            cnt_threads = max(stoi(argv[i + 1]), 1);
+        else if (argument == "--rounds")
+            cnt_rounds = max(stoi(argv[i + 1]), 1);
+    }
+
+    vector<unsigned long> seen_ids(cnt_threads);
+    vector<thread> threads;
+    for (int i = 0; i < cnt_threads; i++)
+        threads.emplace_back(race_for_set42, ref(seen_ids), i);
+    for (thread &t : threads)
+        t.join();
+    for (unsigned long id : seen_ids)
+        check(id == strset42(), "every thread sees the same 42 Set");
+
+    vector<unsigned long> shared_sets;
+    for (int i = 0; i < CNT_SHARED_SETS; i++)
+        shared_sets.push_back(strset_new());
+
+    threads.clear();
+    for (int i = 0; i < cnt_threads; i++)
+        threads.emplace_back(work, cref(shared_sets), i, cnt_rounds);
+    for (thread &t : threads)
+        t.join();
+
+    size_t cnt_shared_values = 0;
+    for (unsigned long id : shared_sets)
+        cnt_shared_values += strset_size(id);
+    check(cnt_shared_values == static_cast<size_t>(cnt_threads) * (cnt_rounds - cnt_rounds / 2),
+          "shared sets contain values which were not removed");
+
+    check_reused_ids();
+#ifdef STRSET_SLOT_BITS
+    check_full_registry();
+#endif
+
+    print_scaling("strset_test calls", cnt_threads, test_own_set);
+    print_scaling("sets created and deleted", cnt_threads, create_and_delete_sets);
+
+    if (cnt_failures > 0) {
+        cout << cnt_failures << " failure(s)" << endl;
+        return 1;
+    }
+    cout << "OK" << endl;
+    return 0;
+}
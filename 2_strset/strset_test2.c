@@ -0,0 +1,64 @@
+#include "strset.h"
+#include "strsetconst.h"
+
+#include <assert.h>
+#include <stdio.h>
+
+int main() {
+    unsigned long s1, s2, s3;
+
+    s1 = strset_new();
+    strset_insert_n(s1, "a\0b", 3);
+    strset_insert_n(s1, "a\0c", 3);
+    strset_insert_n(s1, "a", 1);
+    strset_insert_n(s1, "a\0b", 3);
+    assert(strset_size(s1) == 3);
+    assert(strset_test_n(s1, "a\0b", 3));
+    assert(strset_test_n(s1, "a\0c", 3));
+    assert(!strset_test_n(s1, "a\0", 2));
+    assert(strset_test(s1, "a"));
+
+    strset_insert_n(s1, "", 0);
+    assert(strset_size(s1) == 4);
+    assert(strset_test(s1, ""));
+    strset_insert_n(s1, "\0", 1);
+    assert(strset_size(s1) == 5);
+
+    strset_remove_n(s1, "a\0c", 3);
+    strset_remove_n(s1, "a\0d", 3);
+    strset_remove_n(s1, "a\0cx", 3);
+    assert(!strset_test_n(s1, "a\0c", 3));
+    assert(strset_test_n(s1, "a\0b", 3));
+    assert(strset_size(s1) == 4);
+
+    strset_insert_n(s1, NULL, 0);
+    strset_remove_n(s1, NULL, 1);
+    assert(!strset_test_n(s1, NULL, 1));
+    assert(strset_size(s1) == 4);
+
+    s2 = strset_new();
+    s3 = strset_new();
+    strset_insert_n(s2, "a", 1);
+    strset_insert_n(s3, "a\0", 2);
+    assert(strset_comp(s2, s3) == -1);
+    assert(strset_comp(s3, s2) == 1);
+    strset_insert_n(s2, "a\0", 2);
+    strset_remove_n(s2, "a", 1);
+    assert(strset_comp(s2, s3) == 0);
+
+    strset_delete(s1);
+    strset_insert_n(s1, "a\0b", 3);
+    assert(!strset_test_n(s1, "a\0b", 3));
+    assert(strset_size(s1) == 0);
+
+    strset_insert_n(strset42(), "42\0", 3);
+    strset_remove_n(strset42(), "42", 2);
+    assert(strset_size(strset42()) == 1);
+    assert(strset_test_n(strset42(), "42", 2));
+    assert(!strset_test_n(strset42(), "42\0", 3));
+
+    strset_delete(s2);
+    strset_delete(s3);
+
+    return 0;
+}
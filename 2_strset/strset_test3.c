@@ -0,0 +1,72 @@
+#include "strset.h"
+#include "strsetconst.h"
+
+#include <assert.h>
+#include <stdio.h>
+
+int main() {
+    unsigned long s1, s2, s3, s4;
+    const char *unsorted[] = {"pear", "apple", NULL, "pear", "fig", "apple"};
+    const char *with_nul[] = {"x\0y", "x", "x\0y", "x\0z"};
+    const size_t lengths[] = {3, 1, 3, 3};
+    const char *sorted[] = {"apple", "fig", "pear"};
+    const char *missing[] = {"plum", "fig", "plum", "apple"};
+    int results[6];
+
+    s1 = strset_new();
+    strset_insert_batch(s1, unsorted, NULL, 6, results);
+    assert(results[0] && results[1] && !results[2] && !results[3] && results[4] && !results[5]);
+    assert(strset_size(s1) == 3);
+    strset_insert_batch(s1, unsorted, NULL, 6, NULL);
+    assert(strset_size(s1) == 3);
+
+    strset_test_batch(s1, missing, NULL, 4, results);
+    assert(!results[0] && results[1] && !results[2] && results[3]);
+    strset_remove_batch(s1, missing, NULL, 4, results);
+    assert(!results[0] && results[1] && !results[2] && results[3]);
+    assert(strset_size(s1) == 1);
+    assert(strset_test(s1, "pear"));
+
+    strset_insert_batch(s1, with_nul, lengths, 4, results);
+    assert(results[0] && results[1] && !results[2] && results[3]);
+    assert(strset_size(s1) == 4);
+    strset_remove_batch(s1, with_nul, lengths, 4, results);
+    assert(results[0] && results[1] && !results[2] && results[3]);
+    assert(strset_size(s1) == 1);
+
+    strset_insert_batch(s1, NULL, NULL, 2, results);
+    assert(!results[0] && !results[1]);
+    strset_insert_batch(s1, NULL, NULL, 0, NULL);
+    assert(strset_size(s1) == 1);
+
+    s2 = strset_new_from_sorted(sorted, NULL, 3);
+    s3 = strset_new_from_sorted(unsorted, NULL, 6);
+    assert(strset_size(s2) == 3);
+    assert(strset_size(s3) == 3);
+    assert(strset_comp(s2, s3) == 0);
+    s4 = strset_new_from_sorted(with_nul, lengths, 4);
+    assert(strset_size(s4) == 3);
+    assert(strset_test_n(s4, "x\0z", 3));
+    strset_delete(s4);
+    s4 = strset_new_from_sorted(NULL, NULL, 0);
+    assert(strset_size(s4) == 0);
+
+    strset_delete(s1);
+    strset_insert_batch(s1, sorted, NULL, 3, results);
+    assert(!results[0] && !results[1] && !results[2]);
+    strset_test_batch(s1, sorted, NULL, 3, results);
+    assert(!results[0] && !results[1] && !results[2]);
+
+    strset_insert_batch(strset42(), sorted, NULL, 3, results);
+    assert(!results[0] && !results[1] && !results[2]);
+    strset_remove_batch(strset42(), (const char *[]) {"42"}, NULL, 1, results);
+    assert(!results[0]);
+    strset_test_batch(strset42(), (const char *[]) {"24", "42"}, NULL, 2, results);
+    assert(!results[0] && results[1]);
+
+    strset_delete(s2);
+    strset_delete(s3);
+    strset_delete(s4);
+
+    return 0;
+}
@@ -0,0 +1,76 @@
+#include "strset.h"
+#include "strsetconst.h"
+
+#include <assert.h>
+#include <stdio.h>
+
+int main() {
+    unsigned long s1, s2, empty, r1, r2, r3;
+
+    s1 = strset_new();
+    s2 = strset_new();
+    empty = strset_new();
+    strset_insert(s1, "Ania");
+    strset_insert(s1, "Maria");
+    strset_insert(s1, "Olek");
+    strset_insert(s2, "Alek");
+    strset_insert(s2, "Maria");
+
+    r1 = strset_union(s1, s2);
+    r2 = strset_intersection(s1, s2);
+    r3 = strset_difference(s1, s2);
+    assert(strset_size(r1) == 4);
+    assert(strset_size(r2) == 1 && strset_test(r2, "Maria"));
+    assert(strset_size(r3) == 2 && !strset_test(r3, "Maria"));
+    assert(strset_intersection_size(s1, s2) == 1);
+    strset_delete(r1);
+    strset_delete(r2);
+    strset_delete(r3);
+
+    r1 = strset_union(s1, s1);
+    r2 = strset_intersection(s1, s1);
+    r3 = strset_difference(s1, s1);
+    assert(strset_comp(r1, s1) == 0);
+    assert(strset_comp(r2, s1) == 0);
+    assert(strset_size(r3) == 0);
+    assert(strset_intersection_size(s1, s1) == 3);
+    strset_delete(r1);
+    strset_delete(r2);
+    strset_delete(r3);
+
+    r1 = strset_union(empty, empty);
+    r2 = strset_intersection(s1, empty);
+    r3 = strset_difference(empty, s1);
+    assert(strset_size(r1) == 0 && strset_size(r2) == 0 && strset_size(r3) == 0);
+    assert(strset_intersection_size(empty, s1) == 0);
+    strset_delete(r1);
+    strset_delete(r2);
+    strset_delete(r3);
+
+    strset_delete(s2);
+    r1 = strset_union(s1, s2);
+    r2 = strset_difference(s1, s2);
+    r3 = strset_intersection(s2, s1);
+    assert(strset_comp(r1, s1) == 0 && strset_comp(r2, s1) == 0);
+    assert(strset_size(r3) == 0);
+    assert(strset_intersection_size(s1, s2) == 0);
+    strset_delete(r1);
+    strset_delete(r2);
+    strset_delete(r3);
+
+    strset_insert(s1, "42");
+    r1 = strset_intersection(strset42(), s1);
+    assert(strset_size(r1) == 1 && strset_test(r1, "42"));
+    strset_insert(r1, "24");
+    assert(strset_size(r1) == 2);
+    r2 = strset_difference(strset42(), strset42());
+    assert(strset_size(r2) == 0);
+    assert(strset_intersection_size(strset42(), s1) == 1);
+    strset_delete(r1);
+    strset_delete(r2);
+
+    strset_delete(s1);
+    strset_delete(empty);
+
+    return 0;
+}
@@ -0,0 +1,93 @@
+/*
+  Test of set algebra on sets big enough to be merged in parallel pieces. The library has to be built
+  without debug logs, for concurrent use and with merging split among a few threads whatever the hardware:
+  -DNDEBUG -DSTRSET_CONCURRENT -DSTRSET_MERGE_THREADS=4.
+*/
+
+#include "strset.h"
+#include "strsetconst.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define CNT_NUMBERS 300000
+
+static char numbers[CNT_NUMBERS][8];
+
+/* Creates the set of numbers from 0 to CNT_NUMBERS - 1 divisible by any of divisors, zero ending them. */
+static unsigned long new_of_multiples(const int *divisors) {
+    const char **values = malloc(CNT_NUMBERS * sizeof(const char *));
+    size_t count = 0;
+    unsigned long id;
+
+    for (int i = 0; i < CNT_NUMBERS; i++)
+        for (const int *divisor = divisors; *divisor != 0; divisor++)
+            if (i % *divisor == 0) {
+                values[count++] = numbers[i];
+                break;
+            }
+
+    id = strset_new_from_sorted(values, NULL, count);
+    free(values);
+    return id;
+}
+
+int main() {
+    unsigned long evens, thirds, empty, r1, r2;
+
+    for (int i = 0; i < CNT_NUMBERS; i++)
+        sprintf(numbers[i], "%06d", i);
+
+    evens = new_of_multiples((const int[]) {2, 0});
+    thirds = new_of_multiples((const int[]) {3, 0});
+    empty = strset_new();
+    assert(strset_size(evens) == CNT_NUMBERS / 2);
+    assert(strset_size(thirds) == CNT_NUMBERS / 3);
+
+    r1 = strset_union(evens, thirds);
+    r2 = new_of_multiples((const int[]) {2, 3, 0});
+    assert(strset_size(r1) == 2 * CNT_NUMBERS / 3);
+    assert(strset_comp(r1, r2) == 0);
+    strset_delete(r1);
+    strset_delete(r2);
+
+    r1 = strset_intersection(evens, thirds);
+    r2 = new_of_multiples((const int[]) {6, 0});
+    assert(strset_size(r1) == CNT_NUMBERS / 6);
+    assert(strset_comp(r1, r2) == 0);
+    assert(strset_intersection_size(evens, thirds) == CNT_NUMBERS / 6);
+    assert(strset_intersection_size(thirds, evens) == CNT_NUMBERS / 6);
+    strset_delete(r1);
+
+    r1 = strset_difference(thirds, evens);
+    assert(strset_size(r1) == CNT_NUMBERS / 6);
+    assert(strset_intersection_size(r1, r2) == 0);
+    assert(strset_test(r1, "000003") && !strset_test(r1, "000006"));
+    strset_delete(r1);
+    strset_delete(r2);
+
+    r1 = strset_union(evens, evens);
+    assert(strset_comp(r1, evens) == 0);
+    strset_delete(r1);
+    r1 = strset_difference(evens, evens);
+    assert(strset_size(r1) == 0);
+    strset_delete(r1);
+    assert(strset_intersection_size(evens, evens) == CNT_NUMBERS / 2);
+
+    r1 = strset_union(empty, evens);
+    assert(strset_comp(r1, evens) == 0);
+    strset_delete(r1);
+    r1 = strset_difference(evens, empty);
+    assert(strset_comp(r1, evens) == 0);
+    strset_delete(r1);
+    r1 = strset_intersection(thirds, empty);
+    assert(strset_size(r1) == 0);
+    strset_delete(r1);
+
+    strset_delete(evens);
+    strset_delete(thirds);
+    strset_delete(empty);
+
+    return 0;
+}